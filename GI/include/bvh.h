@@ -0,0 +1,28 @@
+#pragma once
+#include "geometry.h"
+#include "sphere_simd.h"
+#include <cstdint>
+#include <vector>
+
+// 扁平化的BVH节点（32字节），按深度优先顺序存放：
+// 左子节点紧跟在父节点之后，右子节点的下标保存在offset中
+struct BVHNode {
+    float bmin[3], bmax[3]; // 包围盒
+    int offset;             // 叶子：第一个物体在soa中的槽位；内部节点：右子节点下标
+    short count;            // 叶子中的物体数，内部节点为0
+    uint8_t axis;           // 划分轴，最近交点查询按光线方向决定先访问哪个子节点
+    uint8_t occludeFirst;   // 遮挡查询先访问的子节点（0左1右）：表面积较大的子树更可能挡住光线
+};
+
+class BVH {
+public:
+    std::vector<BVHNode> nodes;
+    SphereSoA soa;            // 按叶子顺序排列的球体，每个叶子从SPHERE_LANES对齐的槽位开始
+
+    void build(const Sphere* spheres, int n);          // 基于SAH构建
+    bool intersect(const Ray &r, Real &t, int &id) const; // 最近交点
+    void intersect_packet(RayPacket &p) const;            // 整包光线的最近交点，结果写回p.t和p.id
+    bool occluded(const Ray &r, Real tmax) const;         // (epsilon, tmax)内是否有任意交点，找到即返回
+    void occluded_packet(RayPacket &p) const;             // p.t为各光线的tmax，结束后p.id[i] >= 0表示被遮挡
+    void clear();
+};
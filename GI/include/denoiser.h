@@ -0,0 +1,34 @@
+#pragma once
+#include "film.h"
+#include <vector>
+
+// 边缘保持的à-trous小波降噪（Dammertz 2010，边缘停止函数按SVGF）。
+// 辐射亮度先除以首个交点的反射率（解调），只对光照滤波，颜色边界不会被抹平，滤波后再乘回去。
+// 5×5的B3样条核每次迭代步长加倍（1, 2, 4, ...），每个核上的权重再乘三项边缘停止函数：
+//   exp(-亮度差 / (sigmaLuminance·标准误) - 距离差 / (sigmaDepth·距离梯度·偏移)) · 法线夹角余弦^sigmaNormal
+// 标准误取自累积缓冲的亮度方差，随采样增加而变小，已收敛的区域几乎不被模糊。
+// 各通道按平面存放，每个核偏移对一整行做同样的计算，内层循环可以向量化；行之间多线程并行
+class Denoiser {
+public:
+    int iterations = 5;          // 核的最大步长为2^(iterations-1)
+    float sigmaLuminance = 4;
+    float sigmaNormal = 128;
+    float sigmaDepth = 1;
+
+    // 对film的当前均值降噪，结果（线性辐射亮度）写入out；没有采样的像素输出0
+    void run(const Film &film, std::vector<Vec> &out);
+
+private:
+    int w = 0, h = 0;
+    std::vector<float> cr, cg, cb, var;   // 解调后的光照和亮度均值的方差
+    std::vector<float> tr, tg, tb, tvar;  // 每次迭代的输出，迭代后与上面交换
+    std::vector<float> lum;               // 本次迭代的亮度
+    std::vector<float> invSigma;          // 本次迭代各像素亮度差的缩放：1 / (sigmaLuminance·标准误)
+    std::vector<float> ar, ag, ab;        // 解调用的反射率
+    std::vector<float> nx, ny, nz, z;     // 法线和距离
+    std::vector<float> invDepth;          // 1 / (sigmaDepth·距离梯度)
+    std::vector<float> valid;             // 有采样的像素为1
+
+    void load(const Film &film);
+    void iterate(int step);
+};
\ No newline at end of file
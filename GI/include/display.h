@@ -1,5 +1,6 @@
 #pragma once
 #include "geometry.h"
+#include "render_thread.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
@@ -7,19 +8,32 @@ class Display {
 private:
     GLuint quadVAO, quadVBO; // 全屏四边形渲染所需
     GLuint shaderProgram;    // 着色器程序
-    GLuint pbo;              // 像素缓冲对象
+    GLint exposureLoc, toneMapperLoc, uvScaleLoc, uvMaxLoc;
+
+    // 像素缓冲对象的环：CPU写第N+1帧时驱动还在传输第N帧，每个槽位用fence确认上一次传输已完成后才重写
+    static const int PBO_RING = 3;
+    GLuint pbo[PBO_RING];
+    float* pboPtr[PBO_RING];       // 持久映射的地址，不支持持久映射（GL 4.4以下）时为空，每次上传时不同步地映射
+    GLsync pboFence[PBO_RING];
+    GLuint uploadQuery[PBO_RING];  // 每个槽位传输的GPU耗时，下次使用该槽位时读取
+    bool queryPending[PBO_RING];
+    int pboIndex = 0;
+    int frameW, frameH;            // 最近上传的一帧的分辨率，动态分辨率下可能小于窗口
 
 public:
     GLFWwindow* window;
     GLuint renderTexture;
     int w, h;
-    Vec* framebuffer;
+    float exposure = 1.0f;   // 色调映射前乘到辐射亮度上
+    int toneMapper = 0;      // 0: 截断到[0,1]  1: Reinhard  2: ACES
+    double uploadCpuMs = 0;  // 上传的CPU耗时（等待fence、拷贝、提交），指数平滑
+    double uploadGpuMs = 0;  // 纹理传输的GPU耗时，指数平滑
 
     Display(int width, int height);
     ~Display();
     void init_opengl();
     void setup_quad(); // 设置全屏四边形
-    void update_texture(int totalSamples);
+    void update_texture(const FrameSnapshot &frame); // 上传渲染线程发布的一帧，分辨率不超过窗口
     void render_frame();
     
 private:
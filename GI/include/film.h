@@ -0,0 +1,51 @@
+#pragma once
+#include "geometry.h"
+#include "scheduler.h"
+#include <cstdint>
+#include <vector>
+
+// 相机光线首个交点的特征，供降噪判断边缘；未命中时全为0
+struct HitFeatures {
+    Vec albedo;       // 表面反射率
+    Vec normal;       // 朝向相机一侧的法线
+    Real depth = 0;   // 沿相机光线的距离
+};
+
+// 累积缓冲：逐像素记录辐射亮度之和、亮度平方和与采样数。
+// 重投影沿用的历史按权重折算，各像素的采样数不同，取平均时必须用各自的采样数。
+// 相机移动后重投影会改写前三者，下一个采样的序号单独记录，同一像素不会重复使用采样序号
+class Film {
+public:
+    int w = 0, h = 0;
+    std::vector<Vec> sum;          // 各采样辐射亮度之和
+    std::vector<double> sumSq;     // 亮度（三通道均值）的平方和
+    std::vector<uint32_t> count;   // 采样数（重投影得到的历史按权重折算）
+    std::vector<uint32_t> next;    // 下一个采样的序号，只在clear时归零
+    std::vector<Vec> albedo;       // 以下为各采样首个交点特征之和，与sum一起累加、一起重投影
+    std::vector<Vec> normal;
+    std::vector<float> depth;
+
+    // render_image的工作状态，每个Film各有一份，不同的Film可以同时渲染
+    TileScheduler scheduler;       // tile划分和上一帧各tile的耗时
+
+    Film() = default;
+    Film(int width, int height) {resize(width, height);}
+
+    void resize(int width, int height);
+    void clear();
+
+    void add_sample(int i, const Vec &L, const HitFeatures &f) {
+        Real lum = (L.x + L.y + L.z) * Real(1.0 / 3);
+        sum[i] = sum[i] + L;
+        albedo[i] = albedo[i] + f.albedo;
+        normal[i] = normal[i] + f.normal;
+        depth[i] += (float)f.depth;
+        sumSq[i] += double(lum) * lum;
+        ++count[i];
+        ++next[i];
+    }
+
+    Vec mean(int i) const {return count[i] ? sum[i] / Real(count[i]) : Vec();}
+
+    uint64_t total_samples() const;
+};
\ No newline at end of file
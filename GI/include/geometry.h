@@ -1,33 +1,37 @@
 #pragma once
 #include "utils.h"
+#include "vecmath.h"
 
-enum Refl_t { DIFF, SPEC, REFR };
+// 几何核心的标量类型，由CMake选项GI_PRECISION选择：
+// float构建SIMD宽度翻倍、带宽减半，double构建作为验证用的参考
+#ifdef GI_USE_FLOAT
+typedef float Real;
+#else
+typedef double Real;
+#endif
 
-struct Vec {
-    double x, y, z;
-    Vec(double x_=0, double y_=0, double z_=0);
-    Vec operator+(const Vec &b) const;
-    Vec operator-(const Vec &b) const;
-    Vec operator*(double b) const;
-    Vec operator/(double b) const;
-    Vec mult(const Vec &b) const;
-    Vec& norm();
-    double dot(const Vec &b) const;
-    Vec operator%(const Vec &b) const;
-};
+enum Refl_t { DIFF, SPEC, REFR };
 
-struct Ray {
-    Vec o, d; //起点和方向
-    Ray(Vec o_, Vec d_);
+template <typename T>
+struct RayT {
+    Vec3<T> o, d; //起点和方向
+    RayT() {}
+    RayT(Vec3<T> o_, Vec3<T> d_) : o(o_), d(d_.norm()) {}
 };
 
-struct Sphere {
-    double rad;  //半径
-    Vec p, e, c; //发光体位置，发光体颜色，物体颜色
+template <typename T>
+struct SphereT {
+    T rad;       //半径
+    Vec3<T> p, e, c; //发光体位置，发光体颜色，物体颜色
     Refl_t refl; //反射类型
-    Sphere() : rad(0), p(), e(), c(), refl(DIFF) {}
-    Sphere(double rad_, Vec p_, Vec e_, Vec c_, Refl_t refl_);
-    double intersect(const Ray &r) const;
+    SphereT() : rad(0), p(), e(), c(), refl(DIFF) {}
+    SphereT(T rad_, Vec3<T> p_, Vec3<T> e_, Vec3<T> c_, Refl_t refl_);
+    T intersect(const RayT<T> &r) const;
 };
 
-Vec randomPointOnLight(unsigned short *Xi, const Sphere &light);
\ No newline at end of file
+typedef Vec3<Real> Vec;
+typedef RayT<Real> Ray;
+typedef SphereT<Real> Sphere;
+
+class RNG;
+Vec randomPointOnLight(RNG &rng, const Sphere &light);
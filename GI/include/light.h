@@ -0,0 +1,66 @@
+#pragma once
+#include "geometry.h"
+#include <algorithm>
+#include <vector>
+
+// Walker别名表：建表O(n)，按权重抽取一个下标O(1)，与光源数量无关
+class AliasTable {
+public:
+    void build(const std::vector<double> &weights);
+    void clear();
+
+    // u∈[0,1)，返回抽中的下标和它的概率
+    int sample(Real u, Real &pmf) const {
+        const int n = (int)prob.size();
+        const Real scaled = u * n;
+        const int i = std::min((int)scaled, n - 1);
+        const int k = scaled - i < prob[i] ? i : alias[i];
+        pmf = p[k];
+        return k;
+    }
+
+    Real pmf(int i) const {return p[i];}
+    int size() const {return (int)p.size();}
+
+private:
+    std::vector<Real> prob;  // 第i格留给自己的比例
+    std::vector<int> alias;  // 第i格其余部分归属的下标
+    std::vector<Real> p;     // 各下标的概率
+};
+
+// 球形光源的发射功率（按三通道均值），即辐亮度 × π × 表面积
+Real light_power(const Sphere &s);
+
+// 光源层次结构（Conty & Kulla 2018）的节点，按深度优先顺序存放：左子节点紧跟在父节点之后。
+// 每个节点记录子树内光源的包围盒、发射方向锥和总功率，由此估计对某个着色点的贡献上界
+struct LightNode {
+    float bmin[3], bmax[3];     // 包围盒
+    float axis[3];              // 发射方向锥的轴
+    float cosThetaO;            // 子树内各发射法线偏离轴的最大角度的余弦，-1表示各方向都有
+    float cosThetaE;            // 发射面法线之外还能照到的角度的余弦，球面光源为cos(π/2)=0
+    float power;
+    int offset;                 // 叶子：光源在列表中的位置；内部节点：右子节点下标
+    int parent;                 // 父节点下标，根为-1
+    int leaf;
+};
+
+// 在光源层次结构上按重要性逐层随机选择子节点，抽样代价与光源数成对数关系。
+// 重要性为 功率 × 方向锥朝向着色点的余弦 × 着色面朝向包围盒的余弦 / 距离²，
+// 背对着色面或方向锥照不到着色点的子树概率为0
+class LightBVH {
+public:
+    // lights为光源在spheres中的下标，sample返回的是lights中的位置
+    void build(const Sphere* spheres, const int* lights, int n);
+    void clear();
+
+    // 从着色点x（朝向入射侧的法线nl）按重要性抽取一个光源，u∈[0,1)；所有光源都照不到x时返回-1
+    int sample(const Vec &x, const Vec &nl, Real u, Real &pmf) const;
+    // 第slot个光源被sample抽中的概率
+    Real pmf(int slot, const Vec &x, const Vec &nl) const;
+
+private:
+    std::vector<LightNode> nodes;
+    std::vector<int> leafOf;    // 光源对应的叶子节点
+
+    Real importance(const LightNode &node, const Vec &x, const Vec &nl) const;
+};
\ No newline at end of file
@@ -1,6 +1,32 @@
 #pragma once
 #include "geometry.h"
 #include "camera.h"
+#include "sampler.h"
+#include "film.h"
+#include <atomic>
 
-Vec radiance(const Ray &r, int depth, unsigned short *Xi); // 路径追踪核心
-void render_image(Vec* c, int w, int h, int &totalSamples, int addSamples, const Camera& cam);        // 渲染循环控制
\ No newline at end of file
+// 积分器选择
+enum Integrator {
+    INTEGRATOR_PATH,      // 逐条路径追踪（radiance）
+    INTEGRATOR_WAVEFRONT, // 按材质分批处理的wavefront路径追踪
+};
+extern Integrator render_integrator;
+
+// 一帧内不变的相机参数，按像素坐标生成带抗锯齿抖动的相机光线
+struct CameraFrame {
+    Vec cx, cy, origin, front;
+    int w, h;
+
+    CameraFrame(const Camera &cam, int w, int h);
+    Ray generate(int x, int y, Sampler &sampler) const; // 使用DIM_PIXEL_X/Y
+    Ray center(int x, int y) const;                     // 穿过像素中心、不抖动的光线
+    // generate的逆映射：把点p投影到连续的像素坐标（像素中心为整数），p在相机后方时返回false
+    bool project(const Vec &p, Real &px, Real &py) const;
+};
+
+Vec radiance(const Ray &r, int depth, Sampler &sampler); // 路径追踪核心
+Vec radiance(const Ray &r, Real firstT, int firstId, Sampler &sampler); // 首个交点已知（包追踪的相机光线）
+// 渲染循环控制：每个像素追加addSamples个采样，返回本次追踪的采样总数。
+// cancel非空时每个tile开始前检查，置位后尽快返回0；已完成的tile的采样仍留在film中。
+// tile调度保存在film中，不同的Film可以在不同线程上同时渲染
+uint64_t render_image(Film &film, int addSamples, const Camera& cam, const std::atomic<bool> *cancel = nullptr);
\ No newline at end of file
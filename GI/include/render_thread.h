@@ -0,0 +1,98 @@
+#pragma once
+#include "render.h"
+#include "reprojection.h"
+#include "denoiser.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// 单生产者、单消费者的三重缓冲：写端总有一个独占的槽位，读端总能拿到最近一次发布的完整内容，两端都不加锁、不等待。
+// 中间槽位的下标和"有新内容"标志放在同一个原子量里，发布和取走各只需一次exchange；
+// 写端连续发布多次时读端只看到最新的一次
+template <class T>
+class TripleBuffer {
+public:
+    T& write_buffer() {return slots[back];}
+
+    // 发布写好的内容，写端换到原来的中间槽位继续写
+    void publish() {back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;}
+
+    // 有新发布的内容时换到读端并返回true，否则读端保持不变
+    bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T& read_buffer() const {return slots[front];}
+
+private:
+    static const int INDEX = 3, FRESH = 4;
+    T slots[3];
+    std::atomic<int> middle{1};
+    int front = 0, back = 2;
+};
+
+// 渲染线程发布给显示线程的一帧，线性辐射亮度，每像素RGB三个float
+struct FrameSnapshot {
+    int w = 0, h = 0;
+    std::vector<float> rgb;
+    int scale = 1;           // 相对全分辨率的缩小倍数，动态分辨率下相机移动时大于1
+    double spp = 0;          // 平均每像素采样数
+    uint64_t traced = 0;     // 这一帧追踪的采样数
+};
+
+// 后台渲染线程：独占累积缓冲，循环调用render_image（内部的OpenMP线程组即渲染线程池），
+// 每帧结束后把结果（可选降噪）写入三重缓冲发布；显示线程随时取最新的一帧上传，互不等待。
+// 相机通过另一个三重缓冲投递，同时置位cancel，正在渲染的一帧在下一个tile处中止，
+// 渲染线程随即把累积结果重投影到新视角重新开始，输入延迟与一帧的渲染耗时无关。
+// 动态分辨率：相机移动期间按测得的每像素耗时选择1、1/2或1/4分辨率，使一帧不超过TARGET_FRAME_MS，
+// 显示端用纹理的双线性插值放大。这些帧的耗时本来就短，不被新相机中止，否则连续移动时一帧也完成不了。
+// 相机停止SETTLE_MS后回到全分辨率，各分辨率有各自的累积缓冲和重投影，
+// 全分辨率缓冲中移动之前累积的结果重投影到当前视角后继续累积
+class RenderThread {
+public:
+    static const int SAMPLES_PER_FRAME = 4;
+    static const int LEVELS = 3;                    // 第level级的分辨率为全分辨率的1/2^level
+    static constexpr double TARGET_FRAME_MS = 30;
+    static constexpr double SETTLE_MS = 150;
+
+    RenderThread(int w, int h, const Camera &cam);
+    ~RenderThread();   // 停止并等待渲染线程退出
+
+    // 以下由显示线程调用
+    void set_camera(const Camera &cam);
+    void set_denoise(bool on) {denoiseOn.store(on, std::memory_order_relaxed);}
+    bool denoise() const {return denoiseOn.load(std::memory_order_relaxed);}
+    void set_dynamic_resolution(bool on) {dynamicOn.store(on, std::memory_order_relaxed);}
+    bool dynamic_resolution() const {return dynamicOn.load(std::memory_order_relaxed);}
+    bool acquire_frame() {return frames.acquire();}     // 有新的一帧时返回true
+    const FrameSnapshot& frame() const {return frames.read_buffer();}
+
+private:
+    // 一种分辨率的累积缓冲；stale表示相机变化后还没有重投影到当前视角
+    struct Level {
+        Film film;
+        TemporalReprojection reprojection;
+        bool stale = true;
+    };
+
+    int w, h;
+    Level levels[LEVELS];
+    Camera camera;
+    double secondsPerPixel = 0;   // 相机移动时一帧（重投影加渲染）每像素的耗时，指数平滑，0表示还没有测量
+    Denoiser denoiser;
+    std::vector<Vec> denoised;
+
+    TripleBuffer<Camera> cameras;
+    TripleBuffer<FrameSnapshot> frames;
+    std::atomic<bool> cancel{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> denoiseOn{true};
+    std::atomic<bool> dynamicOn{true};
+    std::thread worker;
+
+    void run();
+    int choose_level() const;
+    void publish(int level, uint64_t traced, bool denoise);
+};
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include "render.h"
+#include <vector>
+
+// 穿过像素中心的主光线的首个交点，用来判断上一帧的累积结果能否沿用到当前视角
+struct GBuffer {
+    int w = 0, h = 0;
+    std::vector<Vec> position;  // 交点
+    std::vector<Vec> normal;    // 朝向相机一侧的法线
+    std::vector<float> depth;   // 沿主光线的距离
+    std::vector<int> id;        // 命中物体，未命中为-1
+
+    void build(const CameraFrame &frame); // 主光线整包求交
+};
+
+// 相机移动时的时域重投影：不清空累积缓冲，而是把每个像素的主光线交点投影回上一视角，
+// 在上一帧的G-buffer和累积结果上做双线性插值。四个相邻像素中只有命中同一物体、法线相近、
+// 交点在同一平面附近的才参与插值，全部被拒绝的像素（新露出的区域）从零开始累积。
+// 只对漫反射表面沿用历史，镜面和玻璃上看到的内容随视角变化，不能直接搬过来。
+// 反射率和法线与视角无关，随辐射亮度一起插值；距离换成当前视角G-buffer中的值。
+// 每次重投影都有插值模糊，历史的采样数折算后不超过maxHistory，新的采样能较快盖过旧的结果
+class TemporalReprojection {
+public:
+    uint32_t maxHistory = 64;      // 沿用的历史最多折算成多少个采样
+    Real normalThreshold = 0.9;    // 法线夹角余弦下限
+    Real planeThreshold = 0.01;    // 到当前交点切平面的距离上限，按到相机的距离计的比例
+
+    // 相机已移动到cam：把film中按上一视角累积的结果变换到新视角，返回沿用了历史的像素数。
+    // 第一次调用（或画面尺寸改变）时没有上一视角，只清空film
+    int update(Film &film, const Camera &cam);
+
+private:
+    GBuffer prev, cur;
+    Camera prevCamera;
+    bool valid = false;
+    std::vector<Vec> sum;          // 重投影结果，完成后与film交换
+    std::vector<double> sumSq;
+    std::vector<uint32_t> count;
+    std::vector<Vec> albedo, normal;
+    std::vector<float> depth;
+};
\ No newline at end of file
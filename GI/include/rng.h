@@ -0,0 +1,86 @@
+#pragma once
+#include "geometry.h"
+#include <cstdint>
+
+// Philox4x32-10计数器型随机数发生器（Salmon et al. 2011）。
+// 输出只由(计数器, 密钥)决定：密钥为(像素编号, 采样序号)，计数器为维度序号，
+// 因此不同像素的随机流互不相关，结果与线程数和调度顺序无关
+const uint32_t PHILOX_M0 = 0xD2511F53u, PHILOX_M1 = 0xCD9E8D57u;
+const uint32_t PHILOX_W0 = 0x9E3779B9u, PHILOX_W1 = 0xBB67AE85u;
+
+inline void philox4x32(uint32_t ctr[4], uint32_t k0, uint32_t k1) {
+    for (int round = 0; round < 10; ++round) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * ctr[0];
+        uint64_t p1 = (uint64_t)PHILOX_M1 * ctr[2];
+        uint32_t c0 = (uint32_t)(p1 >> 32) ^ ctr[1] ^ k0;
+        uint32_t c2 = (uint32_t)(p0 >> 32) ^ ctr[3] ^ k1;
+        ctr[1] = (uint32_t)p1;
+        ctr[3] = (uint32_t)p0;
+        ctr[0] = c0;
+        ctr[2] = c2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+// 32位整数映射到[0,1)
+inline Real u32_to_unit(uint32_t u) {
+#ifdef GI_USE_FLOAT
+    return (u >> 8) * (1.0f / 16777216.0f);
+#else
+    return u * (1.0 / 4294967296.0);
+#endif
+}
+
+// 单个采样的随机流，每次Philox调用产生相邻的4个维度
+class RNG {
+public:
+    RNG(uint32_t pixel, uint32_t sampleIndex) : key0(pixel), key1(sampleIndex) {}
+
+    // 使用批量接口预先算好的第0~3维
+    RNG(uint32_t pixel, uint32_t sampleIndex, const uint32_t firstBlock[4])
+        : key0(pixel), key1(sampleIndex), loaded(0) {
+        for (int i = 0; i < 4; ++i) block[i] = firstBlock[i];
+    }
+
+    // 取下一个维度的[0,1)均匀随机数
+    Real next() {
+        uint32_t b = dim >> 2;
+        if (b != loaded) refill(b);
+        return u32_to_unit(block[dim++ & 3]);
+    }
+
+    // 随机访问第d维（相对于子序列起点），不改变next的位置
+    Real at(uint32_t d) {
+        const uint32_t k = base + d;
+        if (k >> 2 != loaded) refill(k >> 2);
+        return u32_to_unit(block[k & 3]);
+    }
+
+    uint32_t dimension() const {return dim;}
+
+    // 同一(像素, 采样)下编号为stream的独立子序列，用于路径分支；各子序列的维度区间互不重叠
+    RNG substream(uint32_t stream) const {
+        RNG r(key0, key1);
+        r.base = r.dim = stream << 24;
+        return r;
+    }
+
+private:
+    uint32_t key0, key1;
+    uint32_t base = 0;     // 子序列起点
+    uint32_t dim = 0;
+    uint32_t loaded = ~0u; // block中保存的是第几组维度
+    uint32_t block[4];
+
+    void refill(uint32_t b) {
+        block[0] = b;
+        block[1] = block[2] = block[3] = 0;
+        philox4x32(block, key0, key1);
+        loaded = b;
+    }
+};
+
+// 批量接口：为n个采样（像素编号pixels[i]，采样序号samples[i]）生成第0~3维，
+// out按采样连续存放4个uint32。AVX2下一次处理8个采样
+void philox_first_block_batch(const uint32_t* pixels, const uint32_t* samples, int n, uint32_t* out);
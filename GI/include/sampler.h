@@ -0,0 +1,83 @@
+#pragma once
+#include "rng.h"
+#include <cstdint>
+
+// 采样器：按固定的维度编号取[0,1)采样值，同一维度在所有像素、所有采样中含义相同。
+// 维度布局：0、1为像素内抖动，之后每次弹射占BOUNCE_DIMS个维度
+enum SampleDimension {
+    DIM_PIXEL_X,
+    DIM_PIXEL_Y,
+    DIM_BOUNCE_BASE,
+};
+
+// 一次弹射内的维度偏移，相邻两维成对使用的按二维点生成。
+// 每次弹射占8维，BSDF两维总落在同一组Philox输出（4维一组）内，随机采样器每次弹射通常只需算一组
+enum BounceDimension {
+    BOUNCE_BSDF_U,    // 材质采样方向
+    BOUNCE_BSDF_V,
+    BOUNCE_LOBE,      // 玻璃选择反射或折射
+    BOUNCE_RR,        // 俄罗斯轮盘赌
+    BOUNCE_LIGHT,     // 光源选择
+    BOUNCE_LIGHT_U,   // 光源上的采样点
+    BOUNCE_LIGHT_V,
+    BOUNCE_DIMS = 8
+};
+
+inline uint32_t bounce_dim(int bounce, int d) {
+    return DIM_BOUNCE_BASE + bounce * BOUNCE_DIMS + d;
+}
+
+enum SamplerType {
+    SAMPLER_RANDOM, // Philox独立随机数
+    SAMPLER_SOBOL,  // Owen扰乱的Sobol序列
+};
+extern SamplerType render_sampler;
+
+// Owen扰乱Sobol的二维点（Burley 2020）：采样序号先做嵌套均匀置换打乱顺序，
+// 再对Sobol前两维各做一次Owen扰乱；seed取自(像素, 子序列, 维度)，不同维度对之间互不相关
+void sobol_owen_2d(uint32_t index, uint32_t seed, uint32_t &u, uint32_t &v);
+uint32_t sobol_owen_1d(uint32_t index, uint32_t seed);
+uint32_t sample_seed(uint32_t pixel, uint32_t stream, uint32_t dim);
+
+// 单个采样的采样器，类型在构造时取自render_sampler
+class Sampler {
+public:
+    Sampler(uint32_t pixel, uint32_t sampleIndex)
+        : type(render_sampler), pixel(pixel), index(sampleIndex), rng(pixel, sampleIndex) {}
+
+    // 随机采样器使用批量接口预先算好的第0~3维
+    Sampler(uint32_t pixel, uint32_t sampleIndex, const uint32_t firstBlock[4])
+        : type(SAMPLER_RANDOM), pixel(pixel), index(sampleIndex), rng(pixel, sampleIndex, firstBlock) {}
+
+    Real get1D(uint32_t dim) {
+        if (type == SAMPLER_RANDOM) return rng.at(dim);
+        return u32_to_unit(sobol_owen_1d(index, sample_seed(pixel, stream, dim)));
+    }
+
+    // 第dim和dim+1维作为一个二维点
+    void get2D(uint32_t dim, Real &u, Real &v) {
+        if (type == SAMPLER_RANDOM) {
+            u = rng.at(dim);
+            v = rng.at(dim + 1);
+            return;
+        }
+        uint32_t a, b;
+        sobol_owen_2d(index, sample_seed(pixel, stream, dim), a, b);
+        u = u32_to_unit(a);
+        v = u32_to_unit(b);
+    }
+
+    // 编号为stream的独立子序列，用于路径分支
+    Sampler substream(uint32_t s) const {
+        Sampler r = *this;
+        r.stream = s;
+        r.rng = rng.substream(s);
+        return r;
+    }
+
+private:
+    SamplerType type;
+    uint32_t pixel, index;
+    uint32_t stream = 0;
+    RNG rng;
+};
\ No newline at end of file
@@ -1,8 +1,26 @@
 #pragma once
 #include "geometry.h"
 
+struct RayPacket;
+
 extern Sphere* spheres;     // 场景物体数组
 extern int num_spheres;     // 物体数量
+extern int* emitters;       // 发光物体在spheres中的下标，init_scene中建立
+extern int num_emitters;    // 光源数量
 void init_scene();        // 初始化场景函数
-bool scene_intersect(const Ray &r, double &t, int &id); // 场景级碰撞检测
+bool scene_intersect(const Ray &r, Real &t, int &id); // 场景级碰撞检测
+void scene_intersect_packet(RayPacket &p); // 整包光线的碰撞检测，用于相干的相机光线
+bool scene_occluded(const Ray &r, Real tmax); // 阴影/可见性测试：(epsilon, tmax)内有任意遮挡即返回true
+void scene_occluded_packet(RayPacket &p);    // 整包的可见性测试，p.t为各光线的tmax，结束后p.id[i] >= 0表示被遮挡
+
+// 直接光照的光源选择方式
+enum LightSelection {
+    LIGHT_SELECT_POWER, // 按发射功率（别名表），与着色点无关
+    LIGHT_SELECT_BVH,   // 在光源层次结构上按对着色点的重要性逐层选择
+};
+extern LightSelection light_selection;
+
+// 为着色点x（朝向入射侧的法线nl）抽取一个光源，返回spheres下标；没有可用光源时返回-1
+int scene_sample_light(const Vec &x, const Vec &nl, Real u, Real &pmf);
+Real scene_light_pmf(int id, const Vec &x, const Vec &nl); // 物体id被scene_sample_light抽中的概率
 void cleanup_scene();     // 清理场景函数
\ No newline at end of file
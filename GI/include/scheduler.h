@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 屏幕上的矩形区域[x0, x1) × [y0, y1)
+struct Tile {
+    int x0, y0, x1, y1;
+    int cell; // 所属基础tile的编号，耗时按基础tile统计
+};
+
+// 分块渲染调度器。
+// 画面切成TILE_SIZE×TILE_SIZE的基础tile并按Morton顺序排列，相邻tile在空间上也相邻；
+// 上一帧耗时明显高于平均的tile（如玻璃球后方）会被四分，最小到MIN_TILE_SIZE。
+// 每个线程持有tile序列中的一段连续区间，自己从前端取，空闲线程从别人的区间尾部偷走一半，
+// 区间用一个64位原子量表示（高32位begin，低32位end），取和偷都只需一次CAS
+class TileScheduler {
+public:
+    static const int TILE_SIZE = 32;
+    static const int MIN_TILE_SIZE = 8;
+
+    // 生成本帧的tile并按估计耗时均分给numThreads个线程
+    void begin_frame(int w, int h, int numThreads);
+
+    // 取下一个tile的编号，所有tile都已分出时返回-1
+    int next(int thread);
+
+    const Tile& tile(int index) const {return tiles[index];}
+
+    // 记录tile的耗时，下一帧据此划分；每个tile只由取到它的线程写入
+    void record(int index, double seconds) {tileCost[index] = seconds;}
+
+    // 本帧中途取消，各tile的耗时不完整，下一帧仍按之前的历史划分
+    void discard_frame() {tiles.clear();}
+
+private:
+    struct alignas(64) WorkRange {
+        std::atomic<uint64_t> range;
+    };
+
+    int width = 0, height = 0;
+    int cellsX = 0, cellsY = 0;
+    std::vector<Tile> tiles;
+    std::vector<double> tileCost;   // 本帧每个tile的耗时
+    std::vector<double> cellCost;   // 上一帧每个基础tile的耗时，空表示没有历史
+    std::unique_ptr<WorkRange[]> queues;
+    int numQueues = 0;
+
+    void split(const Tile &t, double cost, double limit);
+    bool steal(int thread, int &index);
+};
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#define _USE_MATH_DEFINES
+#include "geometry.h"
+#include "film.h"
+#include "scene.h"
+#include <algorithm>
+#include <math.h>
+
+// 两种积分器（逐路径的radiance和按材质分批的wavefront）共用的材质计算
+
+// 多重重要性采样的power启发式（β=2）：pdf为a的策略所得样本的权重
+inline Real power_heuristic(Real a, Real b) {
+    a *= a;
+    b *= b;
+    return a + b > 0 ? a / (a + b) : 0;
+}
+
+// 球形光源对距其中心dist2（平方）处的点张成的圆锥：返回1 - cos(半顶角)。
+// 远处的小光源cos接近1，直接相减会损失精度，改用等价的 (r²/d²) / (1 + cos)
+inline Real cone_one_minus_cos(const Sphere &light, Real dist2) {
+    const Real s2 = light.rad*light.rad/dist2;
+    return s2 / (1 + sqrt(std::max(Real(0), 1 - s2)));
+}
+
+// connect_light在光源圆锥内均匀采样方向时的立体角pdf（不含光源选择概率），x在光源内部时为0
+inline Real light_cone_pdf(const Sphere &light, const Vec &x) {
+    Vec d = light.p - x;
+    const Real dist2 = d.dot(d);
+    if (dist2 <= light.rad*light.rad) return 0;
+    return 1 / (2*M_PI*cone_one_minus_cos(light, dist2));
+}
+
+// 漫反射的余弦采样pdf（立体角），cosTheta为方向与nl的夹角余弦
+inline Real diffuse_pdf(Real cosTheta) {
+    return cosTheta > 0 ? cosTheta * M_1_PI : 0;
+}
+
+// 到球形光源的直接光照连接：在光源对x张成的圆锥内均匀采样方向（pdf为立体角的倒数），
+// (u1, u2)为采样点，lightPmf为该光源被选中的概率。
+// x在光源内部或采样方向在表面背面时返回false；否则给出阴影光线、沿阴影光线到光源表面的距离和未遮挡时的贡献，
+// 阴影光线在到达光源表面之前没有任何交点时才算未遮挡。
+// 同一方向也可能由漫反射的材质采样命中光源得到，贡献已乘上光源采样一侧的MIS权重，另一侧见emission_weight
+inline bool connect_light(const Sphere &light, Real lightPmf, const Vec &x, const Vec &nl, const Vec &f,
+                          Real u1, Real u2, Ray &shadowRay, Real &lightDist, Vec &contrib) {
+    Vec sw = light.p - x;
+    const Real dist2 = sw.dot(sw);
+    if (dist2 <= light.rad*light.rad) return false;
+    sw = sw * (1/sqrt(dist2));
+
+    // 以光源中心方向为轴的局部坐标系
+    Vec su = ((fabs(sw.x) > 0.1 ? Vec(0,1) : Vec(1))%sw).norm();
+    Vec sv = sw%su;
+    const Real oneMinusCosAMax = cone_one_minus_cos(light, dist2);
+    const Real cosA = 1 - u1*oneMinusCosAMax;
+    const Real sinA = sqrt(std::max(Real(0), 1 - cosA*cosA));
+    const Real phi = 2*M_PI*u2;
+    Vec l = madd(su, cos(phi)*sinA, madd(sv, sin(phi)*sinA, sw*cosA)).norm();
+
+    const Real cosTheta = nl.dot(l);
+    if (cosTheta <= 0) return false;
+
+    shadowRay = Ray(x + nl*1e-3, l);
+    lightDist = light.intersect(shadowRay);
+    if (lightDist <= 0) return false; // 方向在圆锥边缘，数值上擦过光源
+    const Real lightPdf = lightPmf / (2*M_PI*oneMinusCosAMax);
+    const Real weight = power_heuristic(lightPdf, diffuse_pdf(cosTheta));
+    Vec brdf = f * (1.0/M_PI);
+    contrib = brdf.mult(light.e) * (cosTheta * weight / lightPdf);
+    return true;
+}
+
+// 光线命中发光物体id时自发光的MIS权重。光线由上一顶点prevX（法线prevNl）处以立体角pdf bsdfPdf采样得到；
+// bsdfPdf为0表示来自相机或镜面/折射，光源采样无法产生这样的方向，权重为1
+inline Real emission_weight(int id, const Vec &prevX, const Vec &prevNl, Real bsdfPdf) {
+    if (bsdfPdf <= 0) return 1;
+    const Real lightPdf = scene_light_pmf(id, prevX, prevNl) * light_cone_pdf(spheres[id], prevX);
+    return power_heuristic(bsdfPdf, lightPdf);
+}
+
+// 阴影光线的遮挡上界：略短于到光源表面的距离，避免把光源本身算作遮挡物。
+// 余量要盖住float求交的误差（绝对量约1e-4），又不能太大：光源与顶面相交，
+// 擦过开口边缘的光线在光源表面之前不远处就会被顶面挡住
+inline Real shadow_tmax(Real lightDist) {
+    return lightDist * Real(1 - 1e-5) - Real(1e-3);
+}
+
+// 余弦权重的半球采样，(u1, u2)为[0,1)²上的采样点
+inline Vec sample_diffuse(const Vec &nl, Real u1, Real u2) {
+    Real r1 = 2*M_PI*u1;
+    Real r2 = u2;
+    Real r2s = sqrt(r2);
+
+    // 构建局部坐标系
+    Vec w = nl;
+    Vec u = ((fabs(w.x) > 0.1 ? Vec(0,1) : Vec(1))%w).norm();
+    Vec v = w%u;
+    return madd(u, cos(r1)*r2s, madd(v, sin(r1)*r2s, w*sqrt(1 - r2))).norm();
+}
+
+// 理想镜面反射方向
+inline Vec reflect(const Vec &d, const Vec &n) {
+    return (d - n*2*n.dot(d)).norm();
+}
+
+// 玻璃（折射率1.5）的折射方向和Fresnel反射率（Schlick近似）；全反射时返回false
+inline bool refract_dielectric(const Vec &d, const Vec &n, const Vec &nl, Vec &tdir, Real &Re) {
+    bool into = n.dot(nl) > 0;
+    Real nc = 1.0, nt = 1.5;
+    Real nnt = into ? nc/nt : nt/nc;
+    Real ddn = d.dot(nl);
+    Real cos2t = 1 - nnt*nnt*(1 - ddn*ddn);
+    if (cos2t < 0) return false;
+
+    tdir = (d*nnt - n*((into?1:-1)*(ddn*nnt + sqrt(cos2t)))).norm();
+    Real a = nt - nc, b = nt + nc;
+    Real R0 = a*a/(b*b), c = 1 - (into ? -ddn : tdir.dot(n));
+    Re = R0 + (1 - R0)*c*c*c*c*c;
+    return true;
+}
+
+// 相机光线ray在距离t处命中物体id时的首个交点特征，id < 0为未命中
+inline HitFeatures hit_features(const Ray &ray, Real t, int id) {
+    HitFeatures f;
+    if (id < 0) return f;
+    const Sphere &obj = spheres[id];
+    Vec n = (madd(ray.d, t, ray.o) - obj.p).norm();
+    f.albedo = obj.c;
+    f.normal = n.dot(ray.d) < 0 ? n : n * -1;
+    f.depth = t;
+    return f;
+}
+
+// 光源是否发光
+inline bool is_emitter(const Sphere &s) {
+    return s.e.x > 0 || s.e.y > 0 || s.e.z > 0;
+}
\ No newline at end of file
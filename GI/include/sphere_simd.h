@@ -0,0 +1,305 @@
+#pragma once
+#include "geometry.h"
+#include <immintrin.h>
+#include <math.h>
+
+// 一条SIMD指令同时测试的球体数
+#if defined(__AVX512F__)
+constexpr int SPHERE_LANES = 16;
+#elif defined(__AVX2__)
+constexpr int SPHERE_LANES = 8;
+#else
+constexpr int SPHERE_LANES = 8; // 标量回退，交给编译器自动向量化
+#endif
+
+#if defined(__AVX512F__)
+// 把b的符号位加到非负的sq上（copysign）。_mm512_and_ps/_mm512_or_ps属于AVX512DQ，用整数形式只需AVX512F
+inline __m512 copysign_ps(__m512 sq, __m512 b) {
+    const __m512i sign = _mm512_and_si512(_mm512_castps_si512(b), _mm512_set1_epi32(int(0x80000000u)));
+    return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(sq), sign));
+}
+#endif
+
+// 球体几何的SoA存储，数组按64字节对齐，长度为SPHERE_LANES的整数倍。
+// 除半径平方外还存 k = c·c - r²（double计算后转float）：对半径远大于光线起点坐标的球
+// （如1e5量级的墙面），|o-c|² - r² 改用 o·o - 2o·c + k 计算，避免float下的灾难性抵消
+struct SphereSoA {
+    float* cx = nullptr;
+    float* cy = nullptr;
+    float* cz = nullptr;
+    float* r2 = nullptr;
+    float* k = nullptr;
+    int* ids = nullptr;  // 槽位对应的spheres[]下标，空槽位为-1
+    int size = 0;        // 已使用的槽位数（含填充）
+
+    SphereSoA() = default;
+    SphereSoA(const SphereSoA&) = delete;
+    SphereSoA& operator=(const SphereSoA&) = delete;
+    ~SphereSoA();
+
+    void resize(int n);                         // n会向上取整到SPHERE_LANES的倍数
+    void set(int slot, const Sphere &s, int id);
+    void set_empty(int slot);                   // 填充槽位，永远不会命中
+    void clear();
+};
+
+// 预先转换为float的光线
+struct RayF {
+    float ox, oy, oz;
+    float dx, dy, dz;
+    float oo; // o·o
+
+    explicit RayF(const Ray &r)
+        : ox((float)r.o.x), oy((float)r.o.y), oz((float)r.o.z),
+          dx((float)r.d.x), dy((float)r.d.y), dz((float)r.d.z) {
+        oo = ox*ox + oy*oy + oz*oz;
+    }
+};
+
+// 方向分量的倒数，用于slab测试；分量接近0时钳制，避免除零产生inf（-ffast-math下不保证inf的运算语义）
+inline float safe_inv(double d) {
+    double da = fabs(d) > 1e-12 ? d : (d < 0 ? -1e-12 : 1e-12);
+    return (float)(1.0 / da);
+}
+
+// 一组光线的SoA存储（如8×8像素的相机光线），求交时每SPHERE_LANES条光线为一组做SIMD计算
+constexpr int PACKET_SIZE = 64;
+constexpr int PACKET_CHUNKS = PACKET_SIZE / SPHERE_LANES;
+
+struct alignas(64) RayPacket {
+    float ox[PACKET_SIZE], oy[PACKET_SIZE], oz[PACKET_SIZE];
+    float dx[PACKET_SIZE], dy[PACKET_SIZE], dz[PACKET_SIZE];
+    float ix[PACKET_SIZE], iy[PACKET_SIZE], iz[PACKET_SIZE]; // 方向的倒数
+    float oo[PACKET_SIZE];
+    float t[PACKET_SIZE];   // 最近交点距离，未命中为1e20
+    int id[PACKET_SIZE];    // 求交过程中为SoA槽位，结束后为spheres[]下标，未命中为-1
+    int count = 0;          // 有效光线数，tile边缘的包可能不满
+
+    void add(const Ray &r);
+    void pad();             // 求交前用第0条光线填满剩余位置，结果忽略
+};
+
+// 对从first开始的count个槽位（first按SPHERE_LANES对齐）求交，
+// 命中距离在(epsilon, tBest)内时更新tBest和hitSlot。
+// 两个根用数值稳定的形式求出：q = b + sign(b)·sqrt(disc)，根为q和C/q，其中C = |c-o|² - r²
+inline void intersect_spheres(const SphereSoA &s, int first, int count, const RayF &r,
+                              float &tBest, int &hitSlot) {
+    const float epsilon = 1e-4f;
+#if defined(__AVX512F__)
+    const __m512 ox = _mm512_set1_ps(r.ox), oy = _mm512_set1_ps(r.oy), oz = _mm512_set1_ps(r.oz);
+    const __m512 dx = _mm512_set1_ps(r.dx), dy = _mm512_set1_ps(r.dy), dz = _mm512_set1_ps(r.dz);
+    const __m512 oo = _mm512_set1_ps(r.oo);
+    const __m512 eps = _mm512_set1_ps(epsilon);
+    for (int base = first; base < first + count; base += SPHERE_LANES) {
+        __m512 cx = _mm512_load_ps(s.cx + base);
+        __m512 cy = _mm512_load_ps(s.cy + base);
+        __m512 cz = _mm512_load_ps(s.cz + base);
+        __m512 r2 = _mm512_load_ps(s.r2 + base);
+        __m512 k  = _mm512_load_ps(s.k + base);
+
+        __m512 px = _mm512_sub_ps(cx, ox), py = _mm512_sub_ps(cy, oy), pz = _mm512_sub_ps(cz, oz);
+        __m512 b  = _mm512_fmadd_ps(px, dx, _mm512_fmadd_ps(py, dy, _mm512_mul_ps(pz, dz)));
+        __m512 Cs = _mm512_fmadd_ps(px, px, _mm512_fmadd_ps(py, py, _mm512_fmsub_ps(pz, pz, r2)));
+        __m512 oc = _mm512_fmadd_ps(cx, ox, _mm512_fmadd_ps(cy, oy, _mm512_mul_ps(cz, oz)));
+        __m512 Ck = _mm512_fnmadd_ps(_mm512_set1_ps(2.0f), oc, _mm512_add_ps(k, oo));
+        __m512 C  = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(r2, oo, _CMP_GT_OQ), Cs, Ck);
+        __m512 disc = _mm512_fmsub_ps(b, b, C);
+        __mmask16 valid = _mm512_cmp_ps_mask(disc, _mm512_setzero_ps(), _CMP_GE_OQ);
+        if (!valid) continue;
+
+        __m512 sq = _mm512_sqrt_ps(_mm512_max_ps(disc, _mm512_setzero_ps()));
+        __m512 q  = _mm512_add_ps(b, copysign_ps(sq, b));
+        q = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(q, _mm512_setzero_ps(), _CMP_EQ_OQ), q, _mm512_set1_ps(1e-30f));
+        __m512 t1 = _mm512_div_ps(C, q);
+        __m512 tn = _mm512_min_ps(t1, q), tf = _mm512_max_ps(t1, q);
+        __m512 t  = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(tn, eps, _CMP_GT_OQ), tf, tn);
+
+        __mmask16 hit = valid & _mm512_cmp_ps_mask(t, eps, _CMP_GT_OQ)
+                              & _mm512_cmp_ps_mask(t, _mm512_set1_ps(tBest), _CMP_LT_OQ);
+        if (!hit) continue;
+
+        // 归约得到最近的命中，距离相同时取靠前的槽位
+        float tMin = _mm512_mask_reduce_min_ps(hit, t);
+        __mmask16 eq = hit & _mm512_cmp_ps_mask(t, _mm512_set1_ps(tMin), _CMP_EQ_OQ);
+        tBest = tMin;
+        hitSlot = base + __builtin_ctz(eq);
+    }
+#elif defined(__AVX2__)
+    const __m256 ox = _mm256_set1_ps(r.ox), oy = _mm256_set1_ps(r.oy), oz = _mm256_set1_ps(r.oz);
+    const __m256 dx = _mm256_set1_ps(r.dx), dy = _mm256_set1_ps(r.dy), dz = _mm256_set1_ps(r.dz);
+    const __m256 oo = _mm256_set1_ps(r.oo);
+    const __m256 eps = _mm256_set1_ps(epsilon);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    for (int base = first; base < first + count; base += SPHERE_LANES) {
+        __m256 cx = _mm256_load_ps(s.cx + base);
+        __m256 cy = _mm256_load_ps(s.cy + base);
+        __m256 cz = _mm256_load_ps(s.cz + base);
+        __m256 r2 = _mm256_load_ps(s.r2 + base);
+        __m256 k  = _mm256_load_ps(s.k + base);
+
+        __m256 px = _mm256_sub_ps(cx, ox), py = _mm256_sub_ps(cy, oy), pz = _mm256_sub_ps(cz, oz);
+        __m256 b  = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, dx), _mm256_mul_ps(py, dy)),
+                                  _mm256_mul_ps(pz, dz));
+        __m256 Cs = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py)),
+                                                _mm256_mul_ps(pz, pz)), r2);
+        __m256 oc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, ox), _mm256_mul_ps(cy, oy)),
+                                  _mm256_mul_ps(cz, oz));
+        __m256 Ck = _mm256_sub_ps(_mm256_add_ps(k, oo), _mm256_add_ps(oc, oc));
+        __m256 C  = _mm256_blendv_ps(Cs, Ck, _mm256_cmp_ps(r2, oo, _CMP_GT_OQ));
+        __m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), C);
+        __m256 valid = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+        if (!_mm256_movemask_ps(valid)) continue;
+
+        __m256 sq = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+        __m256 q  = _mm256_add_ps(b, _mm256_or_ps(sq, _mm256_and_ps(b, signMask)));
+        q = _mm256_blendv_ps(q, _mm256_set1_ps(1e-30f), _mm256_cmp_ps(q, zero, _CMP_EQ_OQ));
+        __m256 t1 = _mm256_div_ps(C, q);
+        __m256 tn = _mm256_min_ps(t1, q), tf = _mm256_max_ps(t1, q);
+        __m256 t  = _mm256_blendv_ps(tf, tn, _mm256_cmp_ps(tn, eps, _CMP_GT_OQ));
+
+        __m256 hit = _mm256_and_ps(_mm256_and_ps(valid, _mm256_cmp_ps(t, eps, _CMP_GT_OQ)),
+                                   _mm256_cmp_ps(t, _mm256_set1_ps(tBest), _CMP_LT_OQ));
+        int hitBits = _mm256_movemask_ps(hit);
+        if (!hitBits) continue;
+
+        // 归约得到最近的命中，距离相同时取靠前的槽位
+        __m256 tm = _mm256_blendv_ps(_mm256_set1_ps(tBest), t, hit);
+        __m256 m = _mm256_min_ps(tm, _mm256_permute2f128_ps(tm, tm, 1));
+        m = _mm256_min_ps(m, _mm256_permute_ps(m, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm256_min_ps(m, _mm256_permute_ps(m, _MM_SHUFFLE(2, 3, 0, 1)));
+        int eq = hitBits & _mm256_movemask_ps(_mm256_cmp_ps(t, m, _CMP_EQ_OQ));
+        tBest = _mm256_cvtss_f32(m);
+        hitSlot = base + __builtin_ctz(eq);
+    }
+#else
+    for (int i = first; i < first + count; ++i) {
+        float px = s.cx[i] - r.ox, py = s.cy[i] - r.oy, pz = s.cz[i] - r.oz;
+        float b = px*r.dx + py*r.dy + pz*r.dz;
+        float C = s.r2[i] > r.oo ? s.k[i] + r.oo - 2 * (s.cx[i]*r.ox + s.cy[i]*r.oy + s.cz[i]*r.oz)
+                                 : px*px + py*py + pz*pz - s.r2[i];
+        float disc = b*b - C;
+        if (disc < 0) continue;
+        float sq = sqrtf(disc);
+        float q = b >= 0 ? b + sq : b - sq;
+        if (q == 0) q = 1e-30f;
+        float t1 = C / q;
+        float tn = t1 < q ? t1 : q, tf = t1 < q ? q : t1;
+        float t = tn > epsilon ? tn : tf;
+        if (t > epsilon && t < tBest) {
+            tBest = t;
+            hitSlot = i;
+        }
+    }
+#endif
+}
+
+// 包求交：对从first开始的count个槽位，逐个球体与chunks中标记的各组光线求交，
+// 每组SPHERE_LANES条光线。计算与intersect_spheres逐条完全相同，槽位从前往后处理且只在更近时更新，
+// 因此距离相同时同样取靠前的槽位，结果与逐条求交一致
+inline void intersect_spheres_packet(const SphereSoA &s, int first, int count, RayPacket &p, uint32_t chunks) {
+    const float epsilon = 1e-4f;
+    for (int i = first; i < first + count; ++i) {
+        if (s.ids[i] < 0) continue; // 填充槽位
+#if defined(__AVX512F__)
+        const __m512 cx = _mm512_set1_ps(s.cx[i]), cy = _mm512_set1_ps(s.cy[i]), cz = _mm512_set1_ps(s.cz[i]);
+        const __m512 r2 = _mm512_set1_ps(s.r2[i]), k = _mm512_set1_ps(s.k[i]);
+        const __m512 eps = _mm512_set1_ps(epsilon);
+        for (uint32_t m = chunks; m; m &= m - 1) {
+            const int base = __builtin_ctz(m) * SPHERE_LANES;
+            __m512 ox = _mm512_load_ps(p.ox + base), oy = _mm512_load_ps(p.oy + base), oz = _mm512_load_ps(p.oz + base);
+            __m512 dx = _mm512_load_ps(p.dx + base), dy = _mm512_load_ps(p.dy + base), dz = _mm512_load_ps(p.dz + base);
+            __m512 oo = _mm512_load_ps(p.oo + base);
+
+            __m512 px = _mm512_sub_ps(cx, ox), py = _mm512_sub_ps(cy, oy), pz = _mm512_sub_ps(cz, oz);
+            __m512 b  = _mm512_fmadd_ps(px, dx, _mm512_fmadd_ps(py, dy, _mm512_mul_ps(pz, dz)));
+            __m512 Cs = _mm512_fmadd_ps(px, px, _mm512_fmadd_ps(py, py, _mm512_fmsub_ps(pz, pz, r2)));
+            __m512 oc = _mm512_fmadd_ps(cx, ox, _mm512_fmadd_ps(cy, oy, _mm512_mul_ps(cz, oz)));
+            __m512 Ck = _mm512_fnmadd_ps(_mm512_set1_ps(2.0f), oc, _mm512_add_ps(k, oo));
+            __m512 C  = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(r2, oo, _CMP_GT_OQ), Cs, Ck);
+            __m512 disc = _mm512_fmsub_ps(b, b, C);
+            __mmask16 valid = _mm512_cmp_ps_mask(disc, _mm512_setzero_ps(), _CMP_GE_OQ);
+            if (!valid) continue;
+
+            __m512 sq = _mm512_sqrt_ps(_mm512_max_ps(disc, _mm512_setzero_ps()));
+            __m512 q  = _mm512_add_ps(b, copysign_ps(sq, b));
+            q = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(q, _mm512_setzero_ps(), _CMP_EQ_OQ), q, _mm512_set1_ps(1e-30f));
+            __m512 t1 = _mm512_div_ps(C, q);
+            __m512 tn = _mm512_min_ps(t1, q), tf = _mm512_max_ps(t1, q);
+            __m512 t  = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(tn, eps, _CMP_GT_OQ), tf, tn);
+
+            __m512 tBest = _mm512_load_ps(p.t + base);
+            __mmask16 hit = valid & _mm512_cmp_ps_mask(t, eps, _CMP_GT_OQ)
+                                  & _mm512_cmp_ps_mask(t, tBest, _CMP_LT_OQ);
+            if (!hit) continue;
+            _mm512_store_ps(p.t + base, _mm512_mask_blend_ps(hit, tBest, t));
+            __m512i id = _mm512_load_si512(p.id + base);
+            _mm512_store_si512(p.id + base, _mm512_mask_blend_epi32(hit, id, _mm512_set1_epi32(i)));
+        }
+#elif defined(__AVX2__)
+        const __m256 cx = _mm256_set1_ps(s.cx[i]), cy = _mm256_set1_ps(s.cy[i]), cz = _mm256_set1_ps(s.cz[i]);
+        const __m256 r2 = _mm256_set1_ps(s.r2[i]), k = _mm256_set1_ps(s.k[i]);
+        const __m256 eps = _mm256_set1_ps(epsilon);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        for (uint32_t m = chunks; m; m &= m - 1) {
+            const int base = __builtin_ctz(m) * SPHERE_LANES;
+            __m256 ox = _mm256_load_ps(p.ox + base), oy = _mm256_load_ps(p.oy + base), oz = _mm256_load_ps(p.oz + base);
+            __m256 dx = _mm256_load_ps(p.dx + base), dy = _mm256_load_ps(p.dy + base), dz = _mm256_load_ps(p.dz + base);
+            __m256 oo = _mm256_load_ps(p.oo + base);
+
+            __m256 px = _mm256_sub_ps(cx, ox), py = _mm256_sub_ps(cy, oy), pz = _mm256_sub_ps(cz, oz);
+            __m256 b  = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, dx), _mm256_mul_ps(py, dy)),
+                                      _mm256_mul_ps(pz, dz));
+            __m256 Cs = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py)),
+                                                    _mm256_mul_ps(pz, pz)), r2);
+            __m256 oc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, ox), _mm256_mul_ps(cy, oy)),
+                                      _mm256_mul_ps(cz, oz));
+            __m256 Ck = _mm256_sub_ps(_mm256_add_ps(k, oo), _mm256_add_ps(oc, oc));
+            __m256 C  = _mm256_blendv_ps(Cs, Ck, _mm256_cmp_ps(r2, oo, _CMP_GT_OQ));
+            __m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), C);
+            __m256 valid = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+            if (!_mm256_movemask_ps(valid)) continue;
+
+            __m256 sq = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+            __m256 q  = _mm256_add_ps(b, _mm256_or_ps(sq, _mm256_and_ps(b, signMask)));
+            q = _mm256_blendv_ps(q, _mm256_set1_ps(1e-30f), _mm256_cmp_ps(q, zero, _CMP_EQ_OQ));
+            __m256 t1 = _mm256_div_ps(C, q);
+            __m256 tn = _mm256_min_ps(t1, q), tf = _mm256_max_ps(t1, q);
+            __m256 t  = _mm256_blendv_ps(tf, tn, _mm256_cmp_ps(tn, eps, _CMP_GT_OQ));
+
+            __m256 tBest = _mm256_load_ps(p.t + base);
+            __m256 hit = _mm256_and_ps(_mm256_and_ps(valid, _mm256_cmp_ps(t, eps, _CMP_GT_OQ)),
+                                       _mm256_cmp_ps(t, tBest, _CMP_LT_OQ));
+            if (!_mm256_movemask_ps(hit)) continue;
+            _mm256_store_ps(p.t + base, _mm256_blendv_ps(tBest, t, hit));
+            __m256i id = _mm256_load_si256((const __m256i*)(p.id + base));
+            id = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(id),
+                                                      _mm256_castsi256_ps(_mm256_set1_epi32(i)), hit));
+            _mm256_store_si256((__m256i*)(p.id + base), id);
+        }
+#else
+        for (uint32_t m = chunks; m; m &= m - 1) {
+            const int base = __builtin_ctz(m) * SPHERE_LANES;
+            for (int j = base; j < base + SPHERE_LANES; ++j) {
+                float px = s.cx[i] - p.ox[j], py = s.cy[i] - p.oy[j], pz = s.cz[i] - p.oz[j];
+                float b = px*p.dx[j] + py*p.dy[j] + pz*p.dz[j];
+                float C = s.r2[i] > p.oo[j] ? s.k[i] + p.oo[j] - 2 * (s.cx[i]*p.ox[j] + s.cy[i]*p.oy[j] + s.cz[i]*p.oz[j])
+                                            : px*px + py*py + pz*pz - s.r2[i];
+                float disc = b*b - C;
+                if (disc < 0) continue;
+                float sq = sqrtf(disc);
+                float q = b >= 0 ? b + sq : b - sq;
+                if (q == 0) q = 1e-30f;
+                float t1 = C / q;
+                float tn = t1 < q ? t1 : q, tf = t1 < q ? q : t1;
+                float t = tn > epsilon ? tn : tf;
+                if (t > epsilon && t < p.t[j]) {
+                    p.t[j] = t;
+                    p.id[j] = i;
+                }
+            }
+        }
+#endif
+    }
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+
+// 热点路径计数器。开启GI_ENABLE_STATS时每个线程在自己的线程局部计数器上累加，
+// 每次render_image结束时各线程把计数写到自己独占的缓存行，再由调用线程汇总，全程不用原子操作；
+// 关闭时GI_STAT展开为空，没有任何开销
+enum StatCounter {
+    STAT_CAMERA_RAYS,     // 相机光线
+    STAT_SHADOW_RAYS,     // 直接光照的阴影光线
+    STAT_BSDF_RAYS,       // 材质采样产生的后续光线
+    STAT_RR_TERMINATIONS, // 俄罗斯轮盘赌终止
+    STAT_DEPTH_CUTOFFS,   // 超过最大深度被截断
+    STAT_TIR_EVENTS,      // 全反射
+    STAT_SCENE_QUERIES,   // scene_intersect调用次数
+    STAT_OCCLUSION_QUERIES, // scene_occluded调用次数
+    STAT_NODE_VISITS,     // BVH节点包围盒测试
+    STAT_SPHERE_TESTS,    // 球体求交测试（按SoA槽位计）
+    STAT_COUNT
+};
+
+struct RenderStats {
+    uint64_t counters[STAT_COUNT] = {};
+
+    uint64_t operator[](int i) const {return counters[i];}
+    uint64_t rays() const {
+        return counters[STAT_CAMERA_RAYS] + counters[STAT_SHADOW_RAYS] + counters[STAT_BSDF_RAYS];
+    }
+};
+
+const char* stat_name(int counter);
+
+#ifdef GI_ENABLE_STATS
+const bool STATS_ENABLED = true;
+
+struct alignas(64) ThreadStats {
+    uint64_t counters[STAT_COUNT];
+};
+
+extern thread_local ThreadStats thread_stats;
+
+#define GI_STAT(counter) (++thread_stats.counters[counter])
+#define GI_STAT_ADD(counter, n) (thread_stats.counters[counter] += (n))
+
+void stats_begin_frame(int numThreads);   // 并行区之前，由调用线程执行
+void stats_thread_begin();                // 并行区开头，清零本线程的计数器
+void stats_thread_end(int thread);        // 并行区结尾，把本线程的计数写入第thread个槽位
+void stats_end_frame();                   // 并行区之后，汇总各槽位
+#else
+const bool STATS_ENABLED = false;
+
+#define GI_STAT(counter) ((void)0)
+#define GI_STAT_ADD(counter, n) ((void)0)
+
+inline void stats_begin_frame(int) {}
+inline void stats_thread_begin() {}
+inline void stats_thread_end(int) {}
+inline void stats_end_frame() {}
+#endif
+
+// 最近一次render_image的计数，以及自上次stats_reset以来的累计值；未开启统计时全为0
+const RenderStats& stats_last_frame();
+const RenderStats& stats_total();
+void stats_reset();
\ No newline at end of file
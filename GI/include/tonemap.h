@@ -0,0 +1,25 @@
+#pragma once
+#include "geometry.h"
+#include <cstdint>
+
+// 线性辐射亮度到8位显示值的转换：曝光、色调映射、gamma 2.2，可选抖动后量化，与窗口程序片段着色器中的计算一致。
+// 色调映射逐通道进行，三个通道的计算完全相同，输入按连续的float处理，内层循环可以向量化。
+// gamma校正用查找表：按float的位模式取指数和高5位尾数作下标（每个2倍区间32格，共20个区间），
+// 格内线性插值，最大误差约0.01个量化级；低于2^-20的值输出0
+enum ToneMapOperator {
+    TONEMAP_CLAMP,      // 直接截断到[0,1]
+    TONEMAP_REINHARD,   // x / (1 + x)
+    TONEMAP_ACES        // Narkowicz对ACES filmic曲线的拟合
+};
+
+struct ToneMapping {
+    ToneMapOperator op = TONEMAP_CLAMP;
+    float exposure = 1;   // 色调映射前乘到辐射亮度上
+    bool dither = false;  // 量化前加±1级的三角分布噪声，消除暗部平缓渐变中的色带
+};
+
+// n个通道值转换为8位。抖动噪声由值的全局序号决定，index0为in[0]的序号，分块调用与整体调用的结果相同
+void tonemap_8bit(const float* in, int n, uint8_t* out, const ToneMapping &tm, uint32_t index0 = 0);
+
+// n个像素转换为交错的RGB8，多线程并行
+void tonemap_rgb8(const Vec* in, int n, uint8_t* out, const ToneMapping &tm);
\ No newline at end of file
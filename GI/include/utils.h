@@ -4,6 +4,4 @@
 
 double clamp(double x);
 
-int toInt(double x);
-
-double erand48(unsigned short xsubi[3]);
\ No newline at end of file
+int toInt(double x);
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+#include <immintrin.h>
+#include <math.h>
+
+// 头文件内联的向量库。3分量向量按4分量对齐填充（w恒为0），
+// Vec3<float>正好占一个SSE寄存器，Vec3<double>正好占一个AVX寄存器
+template <typename T>
+struct alignas(4 * sizeof(T)) Vec3 {
+    T x, y, z, w;
+
+    constexpr Vec3(T x_=0, T y_=0, T z_=0) : x(x_), y(y_), z(z_), w(0) {}
+
+    constexpr Vec3 operator+(const Vec3 &b) const {return Vec3(x+b.x, y+b.y, z+b.z);}
+    constexpr Vec3 operator-(const Vec3 &b) const {return Vec3(x-b.x, y-b.y, z-b.z);}
+    constexpr Vec3 operator*(T b) const {return Vec3(x*b, y*b, z*b);}
+    constexpr Vec3 operator/(T b) const {return Vec3(x/b, y/b, z/b);}
+    constexpr Vec3 mult(const Vec3 &b) const {return Vec3(x*b.x, y*b.y, z*b.z);}
+
+    // 计算点积
+    constexpr T dot(const Vec3 &b) const {return x*b.x + y*b.y + z*b.z;}
+
+    // 计算叉积
+    constexpr Vec3 operator%(const Vec3 &b) const {return Vec3(y*b.z - z*b.y, z*b.x - x*b.z, x*b.y - y*b.x);}
+
+    Vec3& norm();
+};
+
+// 1/sqrt(x)：float用rsqrt近似加一次牛顿迭代（约23位精度），double保持精确
+inline float fast_rsqrt(float x) {
+#ifdef __SSE__
+    float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+    return r * (1.5f - 0.5f * x * r * r);
+#else
+    return 1.0f / sqrtf(x);
+#endif
+}
+
+inline double fast_rsqrt(double x) {
+    return 1.0 / sqrt(x);
+}
+
+template <typename T>
+inline Vec3<T>& Vec3<T>::norm() {
+    return *this = *this * fast_rsqrt(dot(*this));
+}
+
+// 融合乘加：a*b + c
+template <typename T>
+inline Vec3<T> madd(const Vec3<T> &a, const Vec3<T> &b, const Vec3<T> &c) {
+    return Vec3<T>(a.x*b.x + c.x, a.y*b.y + c.y, a.z*b.z + c.z);
+}
+
+template <typename T>
+inline Vec3<T> madd(const Vec3<T> &a, T b, const Vec3<T> &c) {
+    return Vec3<T>(a.x*b + c.x, a.y*b + c.y, a.z*b + c.z);
+}
+
+#ifdef __SSE__
+inline __m128 simd_load(const Vec3<float> &v) {return _mm_load_ps(&v.x);}
+
+inline Vec3<float> simd_store(__m128 v) {
+    Vec3<float> r;
+    _mm_store_ps(&r.x, v);
+    return r;
+}
+
+inline __m128 simd_madd(__m128 a, __m128 b, __m128 c) {
+#ifdef __FMA__
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+template <>
+inline Vec3<float> madd(const Vec3<float> &a, const Vec3<float> &b, const Vec3<float> &c) {
+    return simd_store(simd_madd(simd_load(a), simd_load(b), simd_load(c)));
+}
+
+template <>
+inline Vec3<float> madd(const Vec3<float> &a, float b, const Vec3<float> &c) {
+    return simd_store(simd_madd(simd_load(a), _mm_set1_ps(b), simd_load(c)));
+}
+#endif
+
+#ifdef __AVX__
+inline __m256d simd_load(const Vec3<double> &v) {return _mm256_load_pd(&v.x);}
+
+inline Vec3<double> simd_store(__m256d v) {
+    Vec3<double> r;
+    _mm256_store_pd(&r.x, v);
+    return r;
+}
+
+inline __m256d simd_madd(__m256d a, __m256d b, __m256d c) {
+#ifdef __FMA__
+    return _mm256_fmadd_pd(a, b, c);
+#else
+    return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+#endif
+}
+
+template <>
+inline Vec3<double> madd(const Vec3<double> &a, const Vec3<double> &b, const Vec3<double> &c) {
+    return simd_store(simd_madd(simd_load(a), simd_load(b), simd_load(c)));
+}
+
+template <>
+inline Vec3<double> madd(const Vec3<double> &a, double b, const Vec3<double> &c) {
+    return simd_store(simd_madd(simd_load(a), _mm256_set1_pd(b), simd_load(c)));
+}
+#endif
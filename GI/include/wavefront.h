@@ -0,0 +1,60 @@
+#pragma once
+#include "render.h"
+#include <vector>
+
+// wavefront路径追踪：一个tile内本轮要采样的全部像素作为一批，路径状态以SoA存放，每次弹射分成若干遍处理：
+//   extend     按方向卦限分桶后整包求交
+//   classify   处理未命中、自发光、深度截断和俄罗斯轮盘赌，按材质放入各自队列
+//   shade      DIFF/SPEC/REFR各一遍，生成下一段光线，DIFF同时产生阴影光线
+//   connect    阴影光线整包做可见性测试，未遮挡的直接光照计入所属采样
+// 同一遍内所有路径走相同的分支，相邻光线方向相近，SIMD利用率和访存局部性都比逐路径追踪好。
+// 维度布局和分支路径的子序列编号都与radiance相同，两种积分器追踪的是同一组路径，
+// 只有累加顺序带来的舍入差异
+class Wavefront {
+public:
+    // 对pixels中的每个像素追踪一个采样（序号取自film.next），结果写入film
+    void trace(const uint32_t* pixels, int n, const CameraFrame &frame, Film &film);
+
+private:
+    // 路径状态，下标为路径槽位
+    std::vector<Real> ox, oy, oz, dx, dy, dz; // 当前光线
+    std::vector<Real> tx, ty, tz;             // 吞吐量
+    std::vector<Real> rrScale;                // 本次弹射俄罗斯轮盘赌的能量补偿
+    std::vector<int> depth;
+    std::vector<int> sample;                  // 所属采样，分支路径与原路径相同
+    std::vector<uint32_t> stream;             // 采样器子序列编号，相机路径为0
+    std::vector<Real> px, py, pz;             // 发出当前光线的顶点，材质采样光线命中光源时用于MIS加权
+    std::vector<Real> pnx, pny, pnz;          // 该顶点朝向入射侧的法线
+    std::vector<Real> bsdfPdf;                // 当前光线的材质采样pdf，来自相机或镜面/折射时为0
+    std::vector<Sampler> samplers;            // 分支路径使用子序列
+    std::vector<float> hitT;
+    std::vector<int> hitId;
+    int numPaths = 0;
+
+    std::vector<int> active, next;   // 本次和下次需要求交的路径
+    std::vector<int> queues[3];      // 按材质（DIFF/SPEC/REFR）分桶的路径
+
+    // 等待求交的阴影光线
+    std::vector<Ray> shadowRays;
+    std::vector<Real> shadowTmax;    // 到光源表面的距离，之内没有交点才算未遮挡
+    std::vector<Vec> shadowContrib;
+    std::vector<int> shadowSample;
+
+    std::vector<Vec> sampleL;        // 每个采样累积的辐射亮度
+    std::vector<HitFeatures> sampleFeatures; // 每个采样相机光线的首个交点特征
+    std::vector<uint32_t> sampleIndex, firstBlocks;
+
+    int add_path(const Ray &r, const Vec &throughput, int depth, int sample, const Sampler &sampler, uint32_t stream);
+    void set_ray(int i, const Ray &r);
+    Ray ray(int i) const;
+    Vec throughput(int i) const {return Vec(tx[i], ty[i], tz[i]);}
+    void set_throughput(int i, const Vec &t) {tx[i] = t.x; ty[i] = t.y; tz[i] = t.z;}
+
+    void generate(const uint32_t* pixels, int n, const CameraFrame &frame, const Film &film);
+    void extend();
+    void classify();
+    void shade_diffuse();
+    void shade_specular();
+    void shade_refractive();
+    void connect();
+};
\ No newline at end of file
@@ -0,0 +1,256 @@
+#define _USE_MATH_DEFINES
+#include "scene.h"
+#include "render.h"
+#include "camera.h"
+#include "denoiser.h"
+#include "tonemap.h"
+#include "utils.h"
+#include "sphere_simd.h"
+#include "stats.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// 热点路径吞吐量测试：固定种子和分辨率，结果以CSV输出便于不同构建之间比较
+
+struct BenchResult {
+    double rays;     // 本次计时内追踪的光线数
+    double samples;  // 本次计时内完成的像素采样数
+    double checksum; // 防止编译器消除计算，同时用于比对结果是否变化
+};
+
+static double now_seconds() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+// 重复执行取最短时间，减少调度抖动的影响
+static void run_bench(const char* name, int repeat, const std::function<BenchResult()>& fn) {
+    BenchResult result = {};
+    double best = 1e30;
+    for (int i = 0; i < repeat; ++i) {
+        double start = now_seconds();
+        result = fn();
+        best = std::min(best, now_seconds() - start);
+    }
+    printf("%s,%.0f,%.0f,%.6f,%.3f,%.1f,%.2f,%.6e\n", name, result.rays, result.samples, best,
+           result.rays / best * 1e-6, result.samples / best, best / result.rays * 1e9, result.checksum);
+    fflush(stdout);
+}
+
+// 开启GI_ENABLE_STATS时光线数取实际追踪的光线（相机、阴影和后续光线），否则只计主光线
+static double traced_rays(double primaryRays) {
+    return STATS_ENABLED ? (double)stats_total().rays() : primaryRays;
+}
+
+// 从盒子内部随机位置发出的随机方向光线
+static std::vector<Ray> make_rays(int n) {
+    std::vector<Ray> rays;
+    rays.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        RNG rng(i, 0x1234);
+        Vec o(1 + 98 * rng.next(), 1 + 80 * rng.next(), 1 + 168 * rng.next());
+        double z = 1 - 2 * rng.next();
+        double r = sqrt(1 - z*z), phi = 2 * M_PI * rng.next();
+        rays.push_back(Ray(o, Vec(r * cos(phi), r * sin(phi), z)));
+    }
+    return rays;
+}
+
+// 与render_image相同的相机光线
+static std::vector<Ray> make_camera_rays(const Camera& cam, int w, int h) {
+    Vec cx = Vec(w * 0.5135 / h, 0, 0);
+    Vec cy = (cx % cam.front).norm() * 0.5135;
+    std::vector<Ray> rays;
+    rays.reserve(w * h);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            Vec d = (cx * ((x + 0.5) / w - 0.5) + cy * ((y + 0.5) / h - 0.5) + cam.front).norm();
+            rays.push_back(Ray(cam.position + d * 140, d));
+        }
+    return rays;
+}
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "  --width <n>    render_image宽度 (默认 256)\n"
+           "  --height <n>   render_image高度 (默认 192)\n"
+           "  --spp <n>      render_image每像素采样数 (默认 4)\n"
+           "  --rays <n>     求交测试的光线数 (默认 1000000)\n"
+           "  --paths <n>    radiance测试的路径数 (默认 100000)\n"
+           "  --repeat <n>   每项重复次数，取最短时间 (默认 3)\n", prog);
+}
+
+int main(int argc, char** argv) {
+    int w = 256, h = 192, spp = 4, numRays = 1000000, numPaths = 100000, repeat = 3;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "--help")) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return 1;
+        }
+        int val = atoi(argv[++i]);
+        if (!strcmp(arg, "--width"))       w = val;
+        else if (!strcmp(arg, "--height")) h = val;
+        else if (!strcmp(arg, "--spp"))    spp = val;
+        else if (!strcmp(arg, "--rays"))   numRays = val;
+        else if (!strcmp(arg, "--paths"))  numPaths = val;
+        else if (!strcmp(arg, "--repeat")) repeat = val;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (val <= 0) {
+            fprintf(stderr, "Invalid value for %s\n", arg);
+            return 1;
+        }
+    }
+
+    init_scene();
+    Camera camera(Vec(50, 45, 295.6));
+    const std::vector<Ray> rays = make_rays(numRays);
+    const std::vector<Ray> camRays = make_camera_rays(camera, w, h);
+
+    printf("bench,rays,samples,seconds,mrays_per_s,samples_per_s,ns_per_ray,checksum\n");
+
+    // 单个球体求交，每次测试计为一条光线
+    run_bench("sphere_intersect", repeat, [&]() {
+        double sum = 0;
+        for (int s = 0; s < num_spheres; ++s) {
+            const Sphere& sphere = spheres[s];
+            for (const Ray& r : rays) sum += sphere.intersect(r);
+        }
+        return BenchResult{double(rays.size()) * num_spheres, 0, sum};
+    });
+
+    // SIMD批量求交，所有球体放在一个SoA中，每次测试计为一条光线
+    SphereSoA soa;
+    soa.resize(num_spheres);
+    for (int s = 0; s < num_spheres; ++s) soa.set(s, spheres[s], s);
+    run_bench("sphere_simd", repeat, [&]() {
+        double sum = 0;
+        for (const Ray& r : rays) {
+            float t = 1e20f;
+            int slot = -1;
+            intersect_spheres(soa, 0, soa.size, RayF(r), t, slot);
+            if (slot >= 0) sum += t;
+        }
+        return BenchResult{double(rays.size()) * num_spheres, 0, sum};
+    });
+
+    // 场景级最近交点查询
+    run_bench("scene_intersect", repeat, [&]() {
+        double sum = 0;
+        for (const Ray& r : rays) {
+            Real t;
+            int id;
+            if (scene_intersect(r, t, id)) sum += t + id;
+        }
+        return BenchResult{double(rays.size()), 0, sum};
+    });
+
+    // 相机光线的首个交点：逐条求交与按8×8像素块打包求交
+    std::vector<int> blockOrder; // 按块重排的相机光线下标，每PACKET_SIZE个一包
+    for (int by = 0; by < h; by += 8)
+        for (int bx = 0; bx < w; bx += 8)
+            for (int y = by; y < std::min(by + 8, h); ++y)
+                for (int x = bx; x < std::min(bx + 8, w); ++x)
+                    blockOrder.push_back(y * w + x);
+
+    run_bench("camera_single", repeat, [&]() {
+        double sum = 0;
+        for (int i : blockOrder) {
+            Real t;
+            int id;
+            if (scene_intersect(camRays[i], t, id)) sum += t + id;
+        }
+        return BenchResult{double(blockOrder.size()), 0, sum};
+    });
+
+    run_bench("camera_packet", repeat, [&]() {
+        double sum = 0;
+        RayPacket packet;
+        for (size_t first = 0; first < blockOrder.size(); first += PACKET_SIZE) {
+            packet.count = 0;
+            for (size_t i = first; i < std::min(first + PACKET_SIZE, blockOrder.size()); ++i)
+                packet.add(camRays[blockOrder[i]]);
+            scene_intersect_packet(packet);
+            for (int i = 0; i < packet.count; ++i)
+                if (packet.id[i] >= 0) sum += packet.t[i] + packet.id[i];
+        }
+        return BenchResult{double(blockOrder.size()), 0, sum};
+    });
+
+    // 单线程的完整路径，每条路径从相机光线出发，计为一个采样
+    run_bench("radiance", repeat, [&]() {
+        double sum = 0;
+        stats_reset();
+        stats_begin_frame(1);
+        stats_thread_begin();
+        for (int i = 0; i < numPaths; ++i) {
+            Sampler sampler(i % camRays.size(), i / camRays.size());
+            GI_STAT(STAT_CAMERA_RAYS);
+            Vec c = radiance(camRays[i % camRays.size()], 0, sampler);
+            sum += c.x + c.y + c.z;
+        }
+        stats_thread_end(0);
+        stats_end_frame();
+        return BenchResult{traced_rays(numPaths), double(numPaths), sum};
+    });
+
+    // 多线程完整渲染，path为逐路径积分器，wavefront为按材质分批的积分器；结果与线程数无关，checksum可直接比较
+    Film film(w, h);
+    auto render_bench = [&]() {
+        film.clear();
+        stats_reset();
+        for (int s = 0; s < spp; ++s)
+            render_image(film, 1, camera);
+        double sum = 0;
+        for (const Vec& c : film.sum) sum += c.x + c.y + c.z;
+        return BenchResult{traced_rays(double(w) * h * spp), double(w) * h * spp, sum};
+    };
+    render_integrator = INTEGRATOR_PATH;
+    run_bench("render_image", repeat, render_bench);
+    render_integrator = INTEGRATOR_WAVEFRONT;
+    run_bench("render_wavefront", repeat, render_bench);
+    render_integrator = INTEGRATOR_PATH;
+
+    // 对上面渲染出的图像降噪，按像素计
+    Denoiser denoiser;
+    std::vector<Vec> denoised;
+    run_bench("denoise", repeat, [&]() {
+        denoiser.run(film, denoised);
+        double sum = 0;
+        for (const Vec& c : denoised) sum += c.x + c.y + c.z;
+        return BenchResult{double(w) * h, double(w) * h, sum};
+    });
+
+    // 降噪结果转换为8位输出（ACES、抖动），单次耗时太短，每次计时内重复转换，按像素计
+    const int TONEMAP_REPEAT = 100;
+    ToneMapping tm;
+    tm.op = TONEMAP_ACES;
+    tm.dither = true;
+    std::vector<uint8_t> rgb8(w * h * 3);
+    run_bench("tonemap", repeat, [&]() {
+        double sum = 0;
+        for (int r = 0; r < TONEMAP_REPEAT; ++r) {
+            tonemap_rgb8(denoised.data(), w * h, rgb8.data(), tm);
+            sum += rgb8[r % rgb8.size()];
+        }
+        return BenchResult{double(w) * h * TONEMAP_REPEAT, double(w) * h * TONEMAP_REPEAT, sum};
+    });
+
+    cleanup_scene();
+    return 0;
+}
@@ -0,0 +1,490 @@
+#include "bvh.h"
+#include "stats.h"
+#include <algorithm>
+#include <cfloat>
+#include <math.h>
+
+namespace {
+
+const int MAX_LEAF_SIZE = SPHERE_LANES; // 叶子最多容纳的物体数，正好一次SIMD求交
+const int NUM_BINS = 16;           // SAH分桶数
+const double TRAVERSAL_COST = 1.0; // 访问一个内部节点的相对代价
+const double INTERSECT_COST = 1.0; // 一次SIMD批量球体求交的相对代价
+// 树的最大深度，即遍历栈的容量：分桶SAH不限制深度，到达这一层的节点强制成为叶子（叶子求交按组循环，物体数不受MAX_LEAF_SIZE限制）
+const int MAX_DEPTH = 64;
+
+// 叶子求交按SPHERE_LANES个一组进行
+inline double leaf_cost(int n) {
+    return INTERSECT_COST * ((n + SPHERE_LANES - 1) / SPHERE_LANES);
+}
+
+struct Bounds {
+    double lo[3] = { DBL_MAX,  DBL_MAX,  DBL_MAX};
+    double hi[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+
+    void grow(const double* plo, const double* phi) {
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], plo[a]);
+            hi[a] = std::max(hi[a], phi[a]);
+        }
+    }
+    void grow(const Bounds &b) { grow(b.lo, b.hi); }
+    void grow(const double* p) { grow(p, p); }
+
+    double area() const {
+        double dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        if (dx < 0 || dy < 0 || dz < 0) return 0;
+        return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+};
+
+struct BuildPrim {
+    Bounds box;
+    double c[3]; // 包围盒中心，用于划分
+    int id;
+};
+
+struct Builder {
+    std::vector<BuildPrim> prims;
+    std::vector<BVHNode>& nodes;
+    std::vector<int> slotIds; // 叶子槽位对应的物体下标，-1为对齐填充
+
+    Builder(std::vector<BVHNode>& n) : nodes(n) {}
+
+    // float包围盒向外取整，保证不会比double包围盒小
+    static void store_bounds(BVHNode &node, const Bounds &b) {
+        for (int a = 0; a < 3; ++a) {
+            float lo = (float)b.lo[a], hi = (float)b.hi[a];
+            if (lo > b.lo[a]) lo = nextafterf(lo, -FLT_MAX);
+            if (hi < b.hi[a]) hi = nextafterf(hi, FLT_MAX);
+            node.bmin[a] = lo;
+            node.bmax[a] = hi;
+        }
+    }
+
+    void make_leaf(int nodeIdx, int begin, int end) {
+        nodes[nodeIdx].offset = (int)slotIds.size();
+        nodes[nodeIdx].count = (short)(end - begin);
+        for (int i = begin; i < end; ++i) slotIds.push_back(prims[i].id);
+        while (slotIds.size() % SPHERE_LANES) slotIds.push_back(-1);
+    }
+
+    static double node_area(const BVHNode &node) {
+        double dx = node.bmax[0] - node.bmin[0], dy = node.bmax[1] - node.bmin[1], dz = node.bmax[2] - node.bmin[2];
+        return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+
+    int build(int begin, int end, int depth) {
+        int nodeIdx = (int)nodes.size();
+        nodes.push_back(BVHNode());
+
+        Bounds box, cbox;
+        for (int i = begin; i < end; ++i) {
+            box.grow(prims[i].box);
+            cbox.grow(prims[i].c);
+        }
+        store_bounds(nodes[nodeIdx], box);
+        nodes[nodeIdx].axis = 0;
+        nodes[nodeIdx].occludeFirst = 0;
+
+        int n = end - begin;
+        if (n == 1 || depth >= MAX_DEPTH) {
+            make_leaf(nodeIdx, begin, end);
+            return nodeIdx;
+        }
+
+        // 分桶SAH：在三个轴上寻找代价最小的划分
+        double bestCost = DBL_MAX;
+        int bestAxis = -1, bestSplit = 0;
+        for (int a = 0; a < 3; ++a) {
+            double extent = cbox.hi[a] - cbox.lo[a];
+            if (extent <= 0) continue;
+
+            Bounds bins[NUM_BINS];
+            int counts[NUM_BINS] = {};
+            for (int i = begin; i < end; ++i) {
+                int b = std::min(NUM_BINS - 1, (int)(NUM_BINS * (prims[i].c[a] - cbox.lo[a]) / extent));
+                bins[b].grow(prims[i].box);
+                counts[b]++;
+            }
+
+            // 从右向左累积，得到每个划分位置右侧的面积和数量
+            double rightArea[NUM_BINS];
+            int rightCount[NUM_BINS];
+            Bounds acc;
+            int cnt = 0;
+            for (int b = NUM_BINS - 1; b > 0; --b) {
+                acc.grow(bins[b]);
+                cnt += counts[b];
+                rightArea[b] = acc.area();
+                rightCount[b] = cnt;
+            }
+
+            acc = Bounds();
+            cnt = 0;
+            for (int b = 1; b < NUM_BINS; ++b) {
+                acc.grow(bins[b-1]);
+                cnt += counts[b-1];
+                if (cnt == 0 || rightCount[b] == 0) continue;
+                double cost = leaf_cost(cnt) * acc.area() + leaf_cost(rightCount[b]) * rightArea[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = a;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        double leafCost = leaf_cost(n);
+        double area = box.area();
+        if (bestAxis >= 0 && area > 0)
+            bestCost = TRAVERSAL_COST + bestCost / area;
+
+        int mid;
+        if (bestAxis >= 0 && (bestCost < leafCost || n > MAX_LEAF_SIZE)) {
+            double lo = cbox.lo[bestAxis], extent = cbox.hi[bestAxis] - lo;
+            BuildPrim* m = std::partition(&prims[begin], &prims[begin] + n, [&](const BuildPrim &p) {
+                return std::min(NUM_BINS - 1, (int)(NUM_BINS * (p.c[bestAxis] - lo) / extent)) < bestSplit;
+            });
+            mid = (int)(m - &prims[0]);
+        } else if (n > MAX_LEAF_SIZE) {
+            // 中心点完全重合时无法按SAH划分，按数量对半分
+            bestAxis = 0;
+            mid = begin + n / 2;
+        } else {
+            make_leaf(nodeIdx, begin, end);
+            return nodeIdx;
+        }
+
+        const int left = build(begin, mid, depth + 1);
+        const int right = build(mid, end, depth + 1);
+        nodes[nodeIdx].offset = right;
+        nodes[nodeIdx].count = 0;
+        nodes[nodeIdx].axis = (uint8_t)bestAxis;
+        nodes[nodeIdx].occludeFirst = node_area(nodes[right]) > node_area(nodes[left]);
+        return nodeIdx;
+    }
+};
+
+// 光线与包围盒的slab测试，区间与[0, tmax]有交集时返回true
+inline bool hit_box(const BVHNode &node, const float* o, const float* inv, float tmax) {
+    float t0 = 0, t1 = tmax;
+    for (int a = 0; a < 3; ++a) {
+        float tn = (node.bmin[a] - o[a]) * inv[a];
+        float tf = (node.bmax[a] - o[a]) * inv[a];
+        if (tn > tf) std::swap(tn, tf);
+        t0 = tn > t0 ? tn : t0;
+        t1 = tf < t1 ? tf : t1;
+    }
+    return t0 <= t1;
+}
+
+// 整个光线包的区间包围：各光线起点和方向倒数在每个轴上的取值范围。
+// 某个轴上方向符号一致时，可以用区间运算得到包内所有光线进入/离开包围盒距离的上下界，
+// 若下界已超过上界则整个包都不会命中，无需逐条测试
+struct PacketInterval {
+    float omin[3], omax[3];
+    float imin[3], imax[3];
+    bool uniform[3]; // 该轴上所有光线方向符号相同
+
+    explicit PacketInterval(const RayPacket &p) {
+        const float* o[3] = {p.ox, p.oy, p.oz};
+        const float* inv[3] = {p.ix, p.iy, p.iz};
+        for (int a = 0; a < 3; ++a) {
+            omin[a] = omax[a] = o[a][0];
+            imin[a] = imax[a] = inv[a][0];
+            for (int i = 1; i < p.count; ++i) {
+                omin[a] = std::min(omin[a], o[a][i]);
+                omax[a] = std::max(omax[a], o[a][i]);
+                imin[a] = std::min(imin[a], inv[a][i]);
+                imax[a] = std::max(imax[a], inv[a][i]);
+            }
+            uniform[a] = imin[a] > 0 || imax[a] < 0;
+        }
+    }
+
+    // 区间[a0,a1]×[b0,b1]的下界和上界
+    static void mul(float a0, float a1, float b0, float b1, float &lo, float &hi) {
+        float p0 = a0*b0, p1 = a0*b1, p2 = a1*b0, p3 = a1*b1;
+        lo = std::min(std::min(p0, p1), std::min(p2, p3));
+        hi = std::max(std::max(p0, p1), std::max(p2, p3));
+    }
+
+    // 返回false表示包内没有光线能在tmax之内命中该包围盒
+    bool overlaps(const BVHNode &node, float tmax) const {
+        float t0 = 0, t1 = tmax;
+        for (int a = 0; a < 3; ++a) {
+            if (!uniform[a]) continue;
+            float nearPlane = imin[a] > 0 ? node.bmin[a] : node.bmax[a];
+            float farPlane  = imin[a] > 0 ? node.bmax[a] : node.bmin[a];
+            float lo, hi, unused;
+            mul(nearPlane - omax[a], nearPlane - omin[a], imin[a], imax[a], lo, unused);
+            mul(farPlane - omax[a], farPlane - omin[a], imin[a], imax[a], unused, hi);
+            t0 = std::max(t0, lo);
+            t1 = std::min(t1, hi);
+        }
+        return t0 <= t1;
+    }
+};
+
+// 对chunks中的每组光线做slab测试，返回有光线命中的组。firstOnly时找到一组就返回
+inline uint32_t hit_box_packet(const BVHNode &node, const RayPacket &p, uint32_t chunks, bool firstOnly) {
+    uint32_t result = 0;
+    for (uint32_t m = chunks; m; m &= m - 1) {
+        const int c = __builtin_ctz(m);
+        const int base = c * SPHERE_LANES;
+#if defined(__AVX512F__)
+        __m512 t0 = _mm512_setzero_ps(), t1 = _mm512_load_ps(p.t + base);
+        const float* o[3] = {p.ox + base, p.oy + base, p.oz + base};
+        const float* inv[3] = {p.ix + base, p.iy + base, p.iz + base};
+        for (int a = 0; a < 3; ++a) {
+            __m512 oa = _mm512_load_ps(o[a]), ia = _mm512_load_ps(inv[a]);
+            __m512 tn = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(node.bmin[a]), oa), ia);
+            __m512 tf = _mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(node.bmax[a]), oa), ia);
+            t0 = _mm512_max_ps(t0, _mm512_min_ps(tn, tf));
+            t1 = _mm512_min_ps(t1, _mm512_max_ps(tn, tf));
+        }
+        bool any = _mm512_cmp_ps_mask(t0, t1, _CMP_LE_OQ) != 0;
+#elif defined(__AVX2__)
+        __m256 t0 = _mm256_setzero_ps(), t1 = _mm256_load_ps(p.t + base);
+        const float* o[3] = {p.ox + base, p.oy + base, p.oz + base};
+        const float* inv[3] = {p.ix + base, p.iy + base, p.iz + base};
+        for (int a = 0; a < 3; ++a) {
+            __m256 oa = _mm256_load_ps(o[a]), ia = _mm256_load_ps(inv[a]);
+            __m256 tn = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.bmin[a]), oa), ia);
+            __m256 tf = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.bmax[a]), oa), ia);
+            t0 = _mm256_max_ps(t0, _mm256_min_ps(tn, tf));
+            t1 = _mm256_min_ps(t1, _mm256_max_ps(tn, tf));
+        }
+        bool any = _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ)) != 0;
+#else
+        bool any = false;
+        for (int j = base; j < base + SPHERE_LANES && !any; ++j) {
+            const float o[3] = {p.ox[j], p.oy[j], p.oz[j]};
+            const float inv[3] = {p.ix[j], p.iy[j], p.iz[j]};
+            any = hit_box(node, o, inv, p.t[j]);
+        }
+#endif
+        if (any) {
+            result |= 1u << c;
+            if (firstOnly) break;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+void BVH::build(const Sphere* spheres, int n) {
+    clear();
+    if (n <= 0) return;
+
+    Builder builder(nodes);
+    builder.prims.resize(n);
+    for (int i = 0; i < n; ++i) {
+        const Sphere &s = spheres[i];
+        BuildPrim &p = builder.prims[i];
+        double c[3] = {s.p.x, s.p.y, s.p.z};
+        // slab测试以float计算，大半径球体的误差与坐标量级成正比，包围盒需留出余量
+        double pad = s.rad + 2e-6 * (std::max(fabs(c[0]), std::max(fabs(c[1]), fabs(c[2]))) + s.rad) + 1e-4;
+        for (int a = 0; a < 3; ++a) {
+            p.box.lo[a] = c[a] - pad;
+            p.box.hi[a] = c[a] + pad;
+            p.c[a] = c[a];
+        }
+        p.id = i;
+    }
+
+    nodes.reserve(2 * n);
+    builder.build(0, n, 0);
+
+    soa.resize((int)builder.slotIds.size());
+    for (int i = 0; i < soa.size; ++i) {
+        int id = builder.slotIds[i];
+        if (id >= 0) soa.set(i, spheres[id], id);
+    }
+}
+
+bool BVH::intersect(const Ray &r, Real &t, int &id) const {
+    float tBest = 1e20f;
+    int hitSlot = -1;
+
+    if (!nodes.empty()) {
+        const RayF rf(r);
+        const float o[3] = {rf.ox, rf.oy, rf.oz};
+        const double d[3] = {r.d.x, r.d.y, r.d.z};
+        float inv[3];
+        int dirNeg[3];
+        for (int a = 0; a < 3; ++a) {
+            inv[a] = safe_inv(d[a]);
+            dirNeg[a] = d[a] < 0;
+        }
+
+        int stack[MAX_DEPTH];
+        int sp = 0, idx = 0;
+        while (true) {
+            const BVHNode &node = nodes[idx];
+            GI_STAT(STAT_NODE_VISITS);
+            if (hit_box(node, o, inv, tBest)) {
+                if (node.count > 0) {
+                    GI_STAT_ADD(STAT_SPHERE_TESTS, node.count);
+                    intersect_spheres(soa, node.offset, node.count, rf, tBest, hitSlot);
+                    if (sp == 0) break;
+                    idx = stack[--sp];
+                } else if (dirNeg[node.axis]) {
+                    // 先访问光线方向上较近的子节点
+                    stack[sp++] = idx + 1;
+                    idx = node.offset;
+                } else {
+                    stack[sp++] = node.offset;
+                    idx = idx + 1;
+                }
+            } else {
+                if (sp == 0) break;
+                idx = stack[--sp];
+            }
+        }
+    }
+
+    t = tBest;
+    id = hitSlot >= 0 ? soa.ids[hitSlot] : -1;
+    return hitSlot >= 0;
+}
+
+void BVH::intersect_packet(RayPacket &p) const {
+    if (nodes.empty() || p.count == 0) return;
+    p.pad();
+
+    const PacketInterval interval(p);
+    const uint32_t allChunks = (1u << ((p.count + SPHERE_LANES - 1) / SPHERE_LANES)) - 1;
+    // 按第0条光线的方向决定子节点访问顺序，相机光线包内方向几乎一致
+    const int dirNeg[3] = {p.dx[0] < 0, p.dy[0] < 0, p.dz[0] < 0};
+    float tMax = 1e20f; // 包内所有光线当前最近交点的最大值
+
+    int stack[MAX_DEPTH];
+    int sp = 0, idx = 0;
+    while (true) {
+        const BVHNode &node = nodes[idx];
+        GI_STAT(STAT_NODE_VISITS);
+        uint32_t chunks = 0;
+        if (interval.overlaps(node, tMax))
+            chunks = hit_box_packet(node, p, allChunks, node.count == 0);
+
+        if (chunks && node.count > 0) {
+            GI_STAT_ADD(STAT_SPHERE_TESTS, node.count * SPHERE_LANES * __builtin_popcount(chunks));
+            intersect_spheres_packet(soa, node.offset, node.count, p, chunks);
+            tMax = p.t[0];
+            for (int i = 1; i < p.count; ++i) tMax = std::max(tMax, p.t[i]);
+            if (sp == 0) break;
+            idx = stack[--sp];
+        } else if (chunks) {
+            if (dirNeg[node.axis]) {
+                stack[sp++] = idx + 1;
+                idx = node.offset;
+            } else {
+                stack[sp++] = node.offset;
+                idx = idx + 1;
+            }
+        } else {
+            if (sp == 0) break;
+            idx = stack[--sp];
+        }
+    }
+
+    for (int i = 0; i < p.count; ++i)
+        p.id[i] = p.id[i] >= 0 ? soa.ids[p.id[i]] : -1;
+}
+
+// 任意交点查询：叶子求交复用intersect_spheres，以tmax为初始上界，一旦命中就返回；
+// 子节点按occludeFirst而不是光线方向排序
+bool BVH::occluded(const Ray &r, Real tmax) const {
+    if (nodes.empty()) return false;
+
+    const RayF rf(r);
+    const float o[3] = {rf.ox, rf.oy, rf.oz};
+    const float inv[3] = {safe_inv(r.d.x), safe_inv(r.d.y), safe_inv(r.d.z)};
+    const float tMax = (float)tmax;
+
+    int stack[MAX_DEPTH];
+    int sp = 0, idx = 0;
+    while (true) {
+        const BVHNode &node = nodes[idx];
+        GI_STAT(STAT_NODE_VISITS);
+        if (hit_box(node, o, inv, tMax)) {
+            if (node.count > 0) {
+                GI_STAT_ADD(STAT_SPHERE_TESTS, node.count);
+                float t = tMax;
+                int hitSlot = -1;
+                intersect_spheres(soa, node.offset, node.count, rf, t, hitSlot);
+                if (hitSlot >= 0) return true;
+                if (sp == 0) break;
+                idx = stack[--sp];
+            } else if (node.occludeFirst) {
+                stack[sp++] = idx + 1;
+                idx = node.offset;
+            } else {
+                stack[sp++] = node.offset;
+                idx = idx + 1;
+            }
+        } else {
+            if (sp == 0) break;
+            idx = stack[--sp];
+        }
+    }
+    return false;
+}
+
+// 整包的任意交点查询：被遮挡的光线把t置为-1，之后的包围盒和球体测试都不会再命中它；
+// 一组光线全部被遮挡后不再参与测试，整包都被遮挡时提前结束
+void BVH::occluded_packet(RayPacket &p) const {
+    if (nodes.empty() || p.count == 0) return;
+    p.pad();
+    for (int i = p.count; i < PACKET_SIZE; ++i) p.t[i] = -1; // 填充的光线视为已完成
+
+    const PacketInterval interval(p);
+    uint32_t active = (1u << ((p.count + SPHERE_LANES - 1) / SPHERE_LANES)) - 1;
+    float tMax = p.t[0];
+    for (int i = 1; i < p.count; ++i) tMax = std::max(tMax, p.t[i]);
+
+    int stack[MAX_DEPTH];
+    int sp = 0, idx = 0;
+    while (true) {
+        const BVHNode &node = nodes[idx];
+        GI_STAT(STAT_NODE_VISITS);
+        uint32_t chunks = 0;
+        if (interval.overlaps(node, tMax))
+            chunks = hit_box_packet(node, p, active, node.count == 0);
+
+        if (chunks && node.count > 0) {
+            GI_STAT_ADD(STAT_SPHERE_TESTS, node.count * SPHERE_LANES * __builtin_popcount(chunks));
+            intersect_spheres_packet(soa, node.offset, node.count, p, chunks);
+            for (uint32_t m = chunks; m; m &= m - 1) {
+                const int base = __builtin_ctz(m) * SPHERE_LANES;
+                bool done = true;
+                for (int i = base; i < base + SPHERE_LANES; ++i) {
+                    if (p.id[i] >= 0) p.t[i] = -1;
+                    done &= p.t[i] < 0;
+                }
+                if (done) active &= ~(1u << __builtin_ctz(m));
+            }
+            if (!active || sp == 0) break;
+            idx = stack[--sp];
+        } else if (chunks) {
+            if (node.occludeFirst) {
+                stack[sp++] = idx + 1;
+                idx = node.offset;
+            } else {
+                stack[sp++] = node.offset;
+                idx = idx + 1;
+            }
+        } else {
+            if (sp == 0) break;
+            idx = stack[--sp];
+        }
+    }
+}
+
+void BVH::clear() {
+    nodes.clear();
+    soa.clear();
+}
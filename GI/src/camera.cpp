@@ -17,11 +17,11 @@ void Camera::update_vectors() {
 }
 
 void Camera::process_keyboard(int key, double deltaTime) {
-    double velocity = moveSpeed * deltaTime;
-    if (key == GLFW_KEY_W) position = position + front * velocity;
-    if (key == GLFW_KEY_S) position = position - front * velocity;
-    if (key == GLFW_KEY_A) position = position - right * velocity;
-    if (key == GLFW_KEY_D) position = position + right * velocity;
+    Real velocity = moveSpeed * deltaTime;
+    if (key == GLFW_KEY_W) position = madd(front, velocity, position);
+    if (key == GLFW_KEY_S) position = madd(front, -velocity, position);
+    if (key == GLFW_KEY_A) position = madd(right, -velocity, position);
+    if (key == GLFW_KEY_D) position = madd(right, velocity, position);
 }
 
 void Camera::process_mouse(double xoffset, double yoffset) {
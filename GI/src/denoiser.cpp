@@ -0,0 +1,179 @@
+#include "denoiser.h"
+#include <math.h>
+#include <algorithm>
+
+// B3样条核的一维权重
+static const float KERNEL[5] = {1.0f/16, 1.0f/4, 3.0f/8, 1.0f/4, 1.0f/16};
+static const float GAUSS3[3] = {1.0f/4, 1.0f/2, 1.0f/4};
+
+// 一个核偏移对一行中n个像素的贡献：p为当前像素，q为偏移后的像素，累加到该行的权重和与加权和上。
+// 各平面互不重叠，单独成函数并标注__restrict，循环才能向量化。
+// expf是向量库函数调用，调用前后要保存所有向量寄存器，因此指数部分、expf和累加分成三个循环
+static void accumulate_tap(int n, float hk, float invDist, float sigmaNormal, float* __restrict e,
+                           const float* __restrict pl, const float* __restrict pnx, const float* __restrict pny,
+                           const float* __restrict pnz, const float* __restrict pz, const float* __restrict sigma,
+                           const float* __restrict depthScale,
+                           const float* __restrict ql, const float* __restrict qnx, const float* __restrict qny,
+                           const float* __restrict qnz, const float* __restrict qz,
+                           const float* __restrict qr, const float* __restrict qg, const float* __restrict qb,
+                           const float* __restrict qv, const float* __restrict qvalid,
+                           float* __restrict sw, float* __restrict sr, float* __restrict sg, float* __restrict sb,
+                           float* __restrict sv) {
+    // 法线项用exp(sigmaNormal·(cos - 1))近似cos^sigmaNormal，cos接近1时两者一致，省去一次对数
+    for (int x = 0; x < n; ++x) {
+        const float cosN = pnx[x]*qnx[x] + pny[x]*qny[x] + pnz[x]*qnz[x];
+        e[x] = -fabsf(pl[x] - ql[x]) * sigma[x]
+               - fabsf(pz[x] - qz[x]) * depthScale[x] * invDist
+               + sigmaNormal * (cosN - 1);
+    }
+    for (int x = 0; x < n; ++x) e[x] = expf(e[x]);
+    for (int x = 0; x < n; ++x) {
+        const float wk = hk * qvalid[x] * e[x];
+        sw[x] += wk;
+        sr[x] += wk * qr[x];
+        sg[x] += wk * qg[x];
+        sb[x] += wk * qb[x];
+        sv[x] += wk * wk * qv[x];
+    }
+}
+
+void Denoiser::load(const Film &film) {
+    w = film.w;
+    h = film.h;
+    const int n = w * h;
+    for (auto *v : {&cr, &cg, &cb, &var, &tr, &tg, &tb, &tvar, &lum, &invSigma, &ar, &ag, &ab,
+                    &nx, &ny, &nz, &z, &invDepth, &valid})
+        v->resize(n);
+
+    #pragma omp parallel for
+    for (int i = 0; i < n; ++i) {
+        const uint32_t c = film.count[i];
+        if (c == 0) {
+            cr[i] = cg[i] = cb[i] = var[i] = 0;
+            ar[i] = ag[i] = ab[i] = 1;
+            nx[i] = ny[i] = nz[i] = z[i] = 0;
+            valid[i] = 0;
+            continue;
+        }
+        const Real inv = Real(1) / c;
+        // 反射率为0的表面（光源、黑色墙面）不解调，按很小的反射率处理，乘回时还原
+        const Vec a = film.albedo[i] * inv;
+        ar[i] = std::max(float(a.x), 0.01f);
+        ag[i] = std::max(float(a.y), 0.01f);
+        ab[i] = std::max(float(a.z), 0.01f);
+        const Vec m = film.sum[i] * inv;
+        cr[i] = float(m.x) / ar[i];
+        cg[i] = float(m.y) / ag[i];
+        cb[i] = float(m.z) / ab[i];
+
+        // 亮度均值的方差，采样不足2个时视为未知，亮度差不参与边缘判断
+        const float lumA = (ar[i] + ag[i] + ab[i]) * (1.0f/3);
+        if (c >= 2) {
+            const double mean = (m.x + m.y + m.z) / 3;
+            const double variance = std::max(0.0, (film.sumSq[i] - mean * mean * c) / (c - 1)) / c;
+            var[i] = float(variance) / (lumA * lumA);
+        } else {
+            var[i] = 1e12f;
+        }
+
+        // 边缘像素的法线是不同朝向的平均，重新归一化，像素与自身的权重总是1
+        Vec nm = film.normal[i];
+        const Real len2 = nm.dot(nm);
+        if (len2 > 0) nm = nm * (1 / sqrt(len2));
+        nx[i] = float(nm.x);
+        ny[i] = float(nm.y);
+        nz[i] = float(nm.z);
+        z[i] = float(film.depth[i] * inv);
+        valid[i] = 1;
+    }
+
+    // 距离梯度取水平和垂直方向中心差分的较大者，倾斜的平面上相邻像素的距离差也能通过
+    #pragma omp parallel for
+    for (int y = 0; y < h; ++y) {
+        const int ym = std::max(y - 1, 0), yp = std::min(y + 1, h - 1);
+        for (int x = 0; x < w; ++x) {
+            const int xm = std::max(x - 1, 0), xp = std::min(x + 1, w - 1);
+            const float gx = fabsf(z[y*w + xp] - z[y*w + xm]) / std::max(xp - xm, 1);
+            const float gy = fabsf(z[yp*w + x] - z[ym*w + x]) / std::max(yp - ym, 1);
+            invDepth[y*w + x] = 1.0f / (sigmaDepth * std::max(gx, gy) + 1e-3f * z[y*w + x] + 1e-6f);
+        }
+    }
+}
+
+void Denoiser::iterate(int step) {
+    // 亮度差的缩放用3×3高斯模糊后的方差，单个像素的方差估计本身噪声很大；顺便求出本次迭代的亮度
+    #pragma omp parallel for
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            float sum = 0;
+            for (int j = -1; j <= 1; ++j)
+                for (int i = -1; i <= 1; ++i) {
+                    const int xx = std::min(std::max(x + i, 0), w - 1), yy = std::min(std::max(y + j, 0), h - 1);
+                    sum += GAUSS3[i + 1] * GAUSS3[j + 1] * var[yy*w + xx];
+                }
+            invSigma[y*w + x] = 1.0f / (sigmaLuminance * sqrtf(sum) + 1e-6f);
+            lum[y*w + x] = (cr[y*w + x] + cg[y*w + x] + cb[y*w + x]) * (1.0f/3);
+        }
+    }
+
+    #pragma omp parallel
+    {
+        std::vector<float> rowW(w), rowR(w), rowG(w), rowB(w), rowV(w), rowE(w);
+
+        #pragma omp for schedule(dynamic, 4)
+        for (int y = 0; y < h; ++y) {
+            std::fill(rowW.begin(), rowW.end(), 0.0f);
+            std::fill(rowR.begin(), rowR.end(), 0.0f);
+            std::fill(rowG.begin(), rowG.end(), 0.0f);
+            std::fill(rowB.begin(), rowB.end(), 0.0f);
+            std::fill(rowV.begin(), rowV.end(), 0.0f);
+            const int p0 = y * w;
+
+            for (int j = -2; j <= 2; ++j) {
+                const int yy = y + j * step;
+                if (yy < 0 || yy >= h) continue;
+                for (int i = -2; i <= 2; ++i) {
+                    const int offset = i * step;
+                    const int x0 = std::max(0, -offset), x1 = std::min(w, w - offset);
+                    const float hk = KERNEL[i + 2] * KERNEL[j + 2];
+                    const float invDist = (i || j) ? 1.0f / (step * sqrtf(float(i*i + j*j))) : 0.0f;
+
+                    // 各指针都从本次有效范围的第一个像素x0开始
+                    const int p = p0 + x0, q = yy * w + x0 + offset;
+                    accumulate_tap(x1 - x0, hk, invDist, sigmaNormal, rowE.data(),
+                                   &lum[p], &nx[p], &ny[p], &nz[p], &z[p], &invSigma[p], &invDepth[p],
+                                   &lum[q], &nx[q], &ny[q], &nz[q], &z[q], &cr[q], &cg[q], &cb[q], &var[q], &valid[q],
+                                   &rowW[x0], &rowR[x0], &rowG[x0], &rowB[x0], &rowV[x0]);
+                }
+            }
+
+            for (int x = 0; x < w; ++x) {
+                const int p = p0 + x;
+                // 有采样的像素自身的权重为中心核权重，总和不会过小；没有采样的像素保持为0
+                if (valid[p] == 0) {
+                    tr[p] = cr[p]; tg[p] = cg[p]; tb[p] = cb[p]; tvar[p] = var[p];
+                    continue;
+                }
+                const float inv = 1.0f / rowW[x];
+                tr[p] = rowR[x] * inv;
+                tg[p] = rowG[x] * inv;
+                tb[p] = rowB[x] * inv;
+                tvar[p] = rowV[x] * inv * inv;
+            }
+        }
+    }
+    cr.swap(tr);
+    cg.swap(tg);
+    cb.swap(tb);
+    var.swap(tvar);
+}
+
+void Denoiser::run(const Film &film, std::vector<Vec> &out) {
+    load(film);
+    for (int it = 0; it < iterations; ++it) iterate(1 << it);
+
+    out.resize(w * h);
+    #pragma omp parallel for
+    for (int i = 0; i < w * h; ++i)
+        out[i] = valid[i] > 0 ? Vec(cr[i] * ar[i], cg[i] * ag[i], cb[i] * ab[i]) : Vec();
+}
\ No newline at end of file
@@ -1,7 +1,11 @@
 #include "display.h"
-#include "utils.h"
 #include <iostream>
-#include <vector>
+#include <string.h>
+
+// 上传耗时的指数平滑
+static double smooth(double avg, double x) {
+    return avg == 0 ? x : avg * 0.9 + x * 0.1;
+}
 
 // 顶点着色器源码
 const char* vertexShaderSource = R"(
@@ -14,23 +18,30 @@ void main() {
     TexCoord = aTexCoord;
 })";
 
-// 片段着色器源码 
+// 片段着色器源码：纹理中是线性辐射亮度，这里做曝光、色调映射和gamma校正，量化由帧缓冲完成
 const char* fragmentShaderSource = R"(
 #version 330 core
 in vec2 TexCoord;
 out vec4 FragColor;
 uniform sampler2D screenTexture;
+uniform float exposure;
+uniform int toneMapper;
+uniform vec2 uvScale;  // 本帧图像在纹理中所占的比例，低分辨率的帧只占纹理左下角
+uniform vec2 uvMax;    // 采样坐标的上限，右、上边缘的插值不混入区域外的旧内容（左、下边缘由CLAMP_TO_EDGE保证）
+// Narkowicz对ACES filmic曲线的拟合
+vec3 aces(vec3 x) {
+    return (x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14);
+}
 void main() {
-    FragColor = texture(screenTexture, TexCoord);
+    // 先截断到有限的范围，ACES拟合式在很大的输入下会得到inf/inf
+    vec3 c = clamp(texture(screenTexture, min(TexCoord * uvScale, uvMax)).rgb * exposure, 0.0, 1e4);
+    if (toneMapper == 1) c = c / (1.0 + c);
+    else if (toneMapper == 2) c = aces(c);
+    FragColor = vec4(pow(clamp(c, 0.0, 1.0), vec3(1.0 / 2.2)), 1.0);
 })";
 
-Display::Display(int width, int height) : w(width), h(height) {
+Display::Display(int width, int height) : frameW(width), frameH(height), w(width), h(height) {
     std::cout << "Initializing display..." << std::endl;
-    framebuffer = new (std::nothrow) Vec[w*h]{};
-    if (!framebuffer) {
-        std::cerr << "Framebuffer allocation failed" << std::endl;
-        return;
-    }
     init_opengl();
     std::cout << "OpenGL initialized" << std::endl;
     compile_shaders();
@@ -40,7 +51,17 @@ Display::Display(int width, int height) : w(width), h(height) {
 }
 
 Display::~Display() {
-    delete[] framebuffer;
+    for (int k = 0; k < PBO_RING; ++k) {
+        if (pboFence[k]) glDeleteSync(pboFence[k]);
+        if (pboPtr[k]) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[k]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(PBO_RING, pbo);
+    glDeleteQueries(PBO_RING, uploadQuery);
+    glDeleteTextures(1, &renderTexture);
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
     glDeleteProgram(shaderProgram);
@@ -56,18 +77,36 @@ void Display::init_opengl() {
     window = glfwCreateWindow(w, h, "GI", NULL, NULL);
     glfwMakeContextCurrent(window);
     gladLoadGL();
+    glfwSwapInterval(1); // 按显示器刷新率交换，显示线程不空转，CPU留给渲染线程
 
-    // 初始化纹理
+    // 初始化纹理：32位浮点，直接存放渲染线程发布的线性辐射亮度
     glGenTextures(1, &renderTexture);
     glBindTexture(GL_TEXTURE_2D, renderTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, w, h, 0, GL_RGB, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    
-    glGenBuffers(1, &pbo);
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
-    glBufferData(GL_PIXEL_UNPACK_BUFFER, w*h*3, NULL, GL_STREAM_DRAW);
+    // 低分辨率的帧只占纹理左下角，左、下边缘的插值不能绕回到纹理另一侧的旧内容
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // 像素缓冲对象的环，支持时持久映射，地址在整个运行期间不变
+    const GLsizeiptr bytes = GLsizeiptr(w) * h * 3 * sizeof(float);
+    glGenBuffers(PBO_RING, pbo);
+    glGenQueries(PBO_RING, uploadQuery);
+    for (int k = 0; k < PBO_RING; ++k) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[k]);
+        pboPtr[k] = nullptr;
+        pboFence[k] = 0;
+        queryPending[k] = false;
+        if (GLAD_GL_VERSION_4_4) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, flags);
+            pboPtr[k] = (float*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
 void Display::compile_shaders() {
@@ -88,6 +127,11 @@ void Display::compile_shaders() {
 
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+
+    exposureLoc = glGetUniformLocation(shaderProgram, "exposure");
+    toneMapperLoc = glGetUniformLocation(shaderProgram, "toneMapper");
+    uvScaleLoc = glGetUniformLocation(shaderProgram, "uvScale");
+    uvMaxLoc = glGetUniformLocation(shaderProgram, "uvMax");
 }
 
 void Display::setup_quad() {
@@ -120,34 +164,55 @@ void Display::setup_quad() {
     glBindVertexArray(0);
 }
 
-void Display::update_texture(int totalSamples) {
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
-    unsigned char* ptr = (unsigned char*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
-    
-    if (totalSamples <= 0) totalSamples = 1; // 避免除以零
-
-    #pragma omp parallel for
-    for (int i = 0; i < w*h; ++i) {
-        Vec color = framebuffer[i];
-        if (totalSamples > 0) color = color / totalSamples;
-        
-        ptr[i*3]   = toInt(color.x);
-        ptr[i*3+1] = toInt(color.y);
-        ptr[i*3+2] = toInt(color.z);
-        // if(ptr[i*3]>0 && ptr[i*3+1]>0 && ptr[i*3+2]>0)
-        //     printf("Pixel %d: (%d, %d, %d)\n", i, ptr[i*3], ptr[i*3+1], ptr[i*3+2]);
+void Display::update_texture(const FrameSnapshot &frame) {
+    const double start = glfwGetTime();
+    const int k = pboIndex;
+    pboIndex = (pboIndex + 1) % PBO_RING;
+    const GLsizeiptr bytes = GLsizeiptr(frame.w) * frame.h * 3 * sizeof(float);
+    frameW = frame.w;
+    frameH = frame.h;
+
+    // 这个槽位上一次的传输发生在PBO_RING次上传之前，通常早已完成，只有GPU落后太多时才会在这里等待
+    if (pboFence[k]) {
+        glClientWaitSync(pboFence[k], GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+        glDeleteSync(pboFence[k]);
+        pboFence[k] = 0;
     }
-    
-    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    if (queryPending[k]) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(uploadQuery[k], GL_QUERY_RESULT, &ns);
+        uploadGpuMs = smooth(uploadGpuMs, ns * 1e-6);
+        queryPending[k] = false;
+    }
+
+    // 快照已是每个像素的平均值（或降噪结果），原样拷贝，色调映射和gamma校正在片段着色器中完成。
+    // 上面已确认GPU不再读这个槽位，不必让驱动再做同步
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[k]);
+    float* ptr = pboPtr[k] ? pboPtr[k] : (float*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    memcpy(ptr, frame.rgb.data(), bytes);
+    if (!pboPtr[k]) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glBeginQuery(GL_TIME_ELAPSED, uploadQuery[k]);
     glBindTexture(GL_TEXTURE_2D, renderTexture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.w, frame.h, GL_RGB, GL_FLOAT, 0);
+    glEndQuery(GL_TIME_ELAPSED);
+    queryPending[k] = true;
+    pboFence[k] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    uploadCpuMs = smooth(uploadCpuMs, (glfwGetTime() - start) * 1000);
 }
 
 void Display::render_frame() {
     glClear(GL_COLOR_BUFFER_BIT);
     
     glUseProgram(shaderProgram);
+    glUniform1f(exposureLoc, exposure);
+    glUniform1i(toneMapperLoc, toneMapper);
+    // 低分辨率的帧由纹理的双线性插值放大到整个窗口
+    glUniform2f(uvScaleLoc, float(frameW) / w, float(frameH) / h);
+    glUniform2f(uvMaxLoc, (frameW - 0.5f) / w, (frameH - 0.5f) / h);
     glBindTexture(GL_TEXTURE_2D, renderTexture);
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
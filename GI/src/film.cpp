@@ -0,0 +1,30 @@
+#include "film.h"
+#include <algorithm>
+
+void Film::resize(int width, int height) {
+    w = width;
+    h = height;
+    sum.assign(w * h, Vec());
+    sumSq.assign(w * h, 0.0);
+    count.assign(w * h, 0);
+    next.assign(w * h, 0);
+    albedo.assign(w * h, Vec());
+    normal.assign(w * h, Vec());
+    depth.assign(w * h, 0.0f);
+}
+
+void Film::clear() {
+    std::fill(sum.begin(), sum.end(), Vec());
+    std::fill(sumSq.begin(), sumSq.end(), 0.0);
+    std::fill(count.begin(), count.end(), 0);
+    std::fill(next.begin(), next.end(), 0);
+    std::fill(albedo.begin(), albedo.end(), Vec());
+    std::fill(normal.begin(), normal.end(), Vec());
+    std::fill(depth.begin(), depth.end(), 0.0f);
+}
+
+uint64_t Film::total_samples() const {
+    uint64_t total = 0;
+    for (uint32_t c : count) total += c;
+    return total;
+}
\ No newline at end of file
@@ -1,65 +1,42 @@
 #define _USE_MATH_DEFINES
 #include "geometry.h"
+#include "rng.h"
 #include <math.h>
 
-const float EPSILON = 1e-4f;
-
-// Vec类方法实现
-Vec::Vec(double x_, double y_, double z_) : x(x_), y(y_), z(z_) {}
-
-Vec Vec::operator+(const Vec &b) const {return Vec(x+b.x, y+b.y, z+b.z);}
-
-Vec Vec::operator-(const Vec &b) const {return Vec(x-b.x, y-b.y, z-b.z);}
-
-Vec Vec::operator*(double b) const {return Vec(x*b, y*b, z*b);}
-
-Vec Vec::operator/(double b) const {return Vec(x/b, y/b, z/b);}
-
-Vec Vec::mult(const Vec &b) const {return Vec(x*b.x, y*b.y, z*b.z);}
-
-Vec& Vec::norm() {
-	double l=sqrt(x*x+y*y+z*z);
-	x/=l;
-	y/=l;
-	z/=l;
-	return *this;
-}
-
-// 计算点积
-double Vec::dot(const Vec &b) const {return x*b.x + y*b.y + z*b.z;}
-
-// 计算叉积
-Vec Vec::operator%(const Vec &b) const {return Vec(y*b.z - z*b.y, z*b.x - x*b.z, x*b.y - y*b.x);}
-
-// Ray构造函数
-Ray::Ray(Vec o_, Vec d_) : o(o_), d(d_.norm()) {}
-
 // Sphere类方法实现
-Sphere::Sphere(double rad_, Vec p_, Vec e_, Vec c_, Refl_t refl_)
+template <typename T>
+SphereT<T>::SphereT(T rad_, Vec3<T> p_, Vec3<T> e_, Vec3<T> c_, Refl_t refl_)
 	: rad(rad_), p(p_), e(e_), c(c_), refl(refl_) {}
 
-double Sphere::intersect(const Ray &r) const {
-    Vec op = p - r.o;
-    float b = op.dot(r.d);
-    float det = b * b - op.dot(op) + rad*rad;
-    
+// 全程使用标量类型T计算，不再隐式收窄到float
+template <typename T>
+T SphereT<T>::intersect(const RayT<T> &r) const {
+    const T epsilon = T(1e-4);
+    Vec3<T> op = p - r.o;
+    T b = op.dot(r.d);
+    T det = b * b - op.dot(op) + rad*rad;
+
     if (det < 0) return 0;
     det = sqrt(det);
-    
-    float t = b - det;
-    if (t > EPSILON) return t;
-    
+
+    T t = b - det;
+    if (t > epsilon) return t;
+
     t = b + det;
-    return (t > EPSILON) ? t : 0;
+    return (t > epsilon) ? t : 0;
 }
 
-Vec randomPointOnLight(unsigned short *Xi, const Sphere &light) {
+// float和double两种精度都实例化，便于对比验证
+template struct SphereT<float>;
+template struct SphereT<double>;
+
+Vec randomPointOnLight(RNG &rng, const Sphere &light) {
     // 在光源表面均匀采样
-    double theta = 2 * M_PI * erand48(Xi);
-    double phi = acos(1 - 2 * erand48(Xi));
-    double x = sin(phi) * cos(theta);
-    double y = sin(phi) * sin(theta); 
-    double z = cos(phi);
+    Real theta = 2 * M_PI * rng.next();
+    Real phi = acos(1 - 2 * rng.next());
+    Real x = sin(phi) * cos(theta);
+    Real y = sin(phi) * sin(theta);
+    Real z = cos(phi);
     
     Vec dir(x, y, z);
     return light.p + dir * light.rad;
@@ -0,0 +1,168 @@
+#define _USE_MATH_DEFINES
+#include "scene.h"
+#include "render.h"
+#include "camera.h"
+#include "denoiser.h"
+#include "tonemap.h"
+#include "stats.h"
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// 离线渲染入口：不创建窗口和OpenGL上下文，渲染结果直接写入PPM文件
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "  --width <n>         图像宽度 (默认 1024)\n"
+           "  --height <n>        图像高度 (默认 768)\n"
+           "  --spp <n>           每像素采样数 (默认 64)\n"
+           "  --pos <x,y,z>       相机位置 (默认 50,45,295.6)\n"
+           "  --dir <x,y,z>       相机朝向，会覆盖 --yaw/--pitch\n"
+           "  --yaw <deg>         偏航角 (默认 -90)\n"
+           "  --pitch <deg>       俯仰角 (默认 0)\n"
+           "  --output <file>     输出文件 (默认 image.ppm)\n"
+           "  --integrator <name> path 或 wavefront (默认 path)\n"
+           "  --sampler <name>    random 或 sobol (默认 sobol)\n"
+           "  --lights <name>     直接光照的光源选择：power 或 bvh (默认 bvh)\n"
+           "  --denoise <n>       输出前做n次à-trous降噪迭代，0为不降噪 (默认 0)\n"
+           "  --exposure <x>      色调映射前乘到辐射亮度上的曝光 (默认 1)\n"
+           "  --tonemap <name>    clamp、reinhard 或 aces (默认 clamp)\n"
+           "  --dither <0|1>      量化前加抖动噪声 (默认 0)\n", prog);
+}
+
+static bool parse_vec(const char* s, Vec& v) {
+    double x, y, z;
+    if (sscanf(s, "%lf,%lf,%lf", &x, &y, &z) != 3) return false;
+    v = Vec(x, y, z);
+    return true;
+}
+
+// 写出二进制PPM，渲染缓冲区第0行在图像底部，需要上下翻转
+static bool write_ppm(const char* path, int w, int h, const std::vector<Vec> &image, const ToneMapping &tm) {
+    std::vector<uint8_t> rgb(w * h * 3);
+    tonemap_rgb8(image.data(), w * h, rgb.data(), tm);
+
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+    for (int y = h - 1; y >= 0; --y)
+        fwrite(&rgb[y * w * 3], 1, w * 3, f);
+    return fclose(f) == 0;
+}
+
+int main(int argc, char** argv) {
+    int w = 1024, h = 768, spp = 64;
+    Vec pos(50, 45, 295.6), dir;
+    bool hasDir = false;
+    double yaw = -90, pitch = 0;
+    const char* output = "image.ppm";
+    Denoiser denoiser;
+    denoiser.iterations = 0;
+    ToneMapping tm;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "--help")) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return 1;
+        }
+        const char* val = argv[++i];
+        bool ok = true;
+        if (!strcmp(arg, "--width"))       ok = (w = atoi(val)) > 0;
+        else if (!strcmp(arg, "--height")) ok = (h = atoi(val)) > 0;
+        else if (!strcmp(arg, "--spp"))    ok = (spp = atoi(val)) > 0;
+        else if (!strcmp(arg, "--pos"))    ok = parse_vec(val, pos);
+        else if (!strcmp(arg, "--dir"))    ok = hasDir = parse_vec(val, dir);
+        else if (!strcmp(arg, "--yaw"))    yaw = atof(val);
+        else if (!strcmp(arg, "--pitch"))  pitch = atof(val);
+        else if (!strcmp(arg, "--output")) output = val;
+        else if (!strcmp(arg, "--denoise")) ok = (denoiser.iterations = atoi(val)) >= 0;
+        else if (!strcmp(arg, "--exposure")) ok = (tm.exposure = atof(val)) > 0;
+        else if (!strcmp(arg, "--dither"))   tm.dither = atoi(val) != 0;
+        else if (!strcmp(arg, "--tonemap")) {
+            if (!strcmp(val, "clamp"))         tm.op = TONEMAP_CLAMP;
+            else if (!strcmp(val, "reinhard")) tm.op = TONEMAP_REINHARD;
+            else if (!strcmp(val, "aces"))     tm.op = TONEMAP_ACES;
+            else ok = false;
+        }
+        else if (!strcmp(arg, "--integrator")) {
+            if (!strcmp(val, "path"))           render_integrator = INTEGRATOR_PATH;
+            else if (!strcmp(val, "wavefront")) render_integrator = INTEGRATOR_WAVEFRONT;
+            else ok = false;
+        }
+        else if (!strcmp(arg, "--sampler")) {
+            if (!strcmp(val, "random"))     render_sampler = SAMPLER_RANDOM;
+            else if (!strcmp(val, "sobol")) render_sampler = SAMPLER_SOBOL;
+            else ok = false;
+        }
+        else if (!strcmp(arg, "--lights")) {
+            if (!strcmp(val, "power"))    light_selection = LIGHT_SELECT_POWER;
+            else if (!strcmp(val, "bvh")) light_selection = LIGHT_SELECT_BVH;
+            else ok = false;
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid value for %s: %s\n", arg, val);
+            return 1;
+        }
+    }
+
+    // 相机朝向由yaw/pitch决定，给定方向向量时换算成对应角度
+    Camera camera(pos);
+    if (hasDir) {
+        dir.norm();
+        camera.yaw = atan2(dir.z, dir.x);
+        camera.pitch = asin(dir.y);
+    } else {
+        camera.yaw = yaw * M_PI / 180;
+        camera.pitch = pitch * M_PI / 180;
+    }
+    camera.update_vectors();
+
+    Film film(w, h);
+    init_scene();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < spp; ++s)
+        render_image(film, 1, camera);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Rendered %dx%d @ %.2f spp in %.2f s\n", w, h, double(film.total_samples()) / (w * h), seconds);
+    if (STATS_ENABLED) {
+        const RenderStats &stats = stats_total();
+        for (int i = 0; i < STAT_COUNT; ++i)
+            printf("  %-18s %llu\n", stat_name(i), (unsigned long long)stats[i]);
+        printf("  %.2f Mrays/s\n", stats.rays() / seconds * 1e-6);
+    }
+
+    cleanup_scene();
+
+    std::vector<Vec> image(w * h);
+    if (denoiser.iterations > 0) {
+        start = std::chrono::steady_clock::now();
+        denoiser.run(film, image);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Denoised (%d iterations) in %.1f ms\n", denoiser.iterations, seconds * 1e3);
+    } else {
+        for (int i = 0; i < w * h; ++i) image[i] = film.mean(i);
+    }
+
+    start = std::chrono::steady_clock::now();
+    if (!write_ppm(output, w, h, image, tm)) {
+        fprintf(stderr, "Failed to write %s\n", output);
+        return 1;
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Saved %s in %.1f ms\n", output, seconds * 1e3);
+    return 0;
+}
@@ -0,0 +1,352 @@
+#define _USE_MATH_DEFINES
+#include "light.h"
+#include <math.h>
+
+// Vose的建表方法：权重归一化为平均1后分成不足和富余两组，每次用一个富余项填满一个不足项
+void AliasTable::build(const std::vector<double> &weights) {
+    const int n = (int)weights.size();
+    prob.assign(n, 1);
+    alias.assign(n, 0);
+    p.assign(n, 0);
+
+    double total = 0;
+    for (double w : weights) total += w;
+    if (n == 0 || total <= 0) {
+        for (int i = 0; i < n; ++i) p[i] = Real(1.0 / n);
+        for (int i = 0; i < n; ++i) alias[i] = i;
+        return;
+    }
+
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+    for (int i = 0; i < n; ++i) {
+        p[i] = Real(weights[i] / total);
+        scaled[i] = weights[i] / total * n;
+        (scaled[i] < 1 ? small : large).push_back(i);
+        alias[i] = i;
+    }
+    while (!small.empty() && !large.empty()) {
+        const int s = small.back(), l = large.back();
+        small.pop_back();
+        prob[s] = Real(scaled[s]);
+        alias[s] = l;
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // 剩下的项只差舍入误差，都视为恰好填满
+    for (int i : small) prob[i] = 1;
+    for (int i : large) prob[i] = 1;
+}
+
+void AliasTable::clear() {
+    prob.clear();
+    alias.clear();
+    p.clear();
+}
+
+Real light_power(const Sphere &s) {
+    return Real((s.e.x + s.e.y + s.e.z) / 3 * M_PI * 4 * M_PI * s.rad * s.rad);
+}
+
+namespace {
+
+const int NUM_BINS = 12;                  // 划分时的分桶数
+const Real ONE_MINUS_EPS = Real(0.99999994);
+
+// 发射方向锥：轴、张角θo的余弦和额外照射范围θe的余弦
+struct Cone {
+    Vec axis = Vec(0, 0, 1);
+    double cosO = 1, cosE = 1;
+    bool empty = true;
+};
+
+// 两个方向锥的并（Conty & Kulla 2018，pbrt-v4 DirectionCone::Union）
+Cone merge(const Cone &a, const Cone &b) {
+    if (a.empty) return b;
+    if (b.empty) return a;
+    Cone r;
+    r.empty = false;
+    r.cosE = std::min(a.cosE, b.cosE);
+    if (a.cosO <= -1 || b.cosO <= -1) {
+        r.cosO = -1;
+        return r;
+    }
+
+    const double thetaA = acos(a.cosO), thetaB = acos(b.cosO);
+    const double thetaD = acos(std::max(-1.0, std::min(1.0, (double)a.axis.dot(b.axis))));
+    if (std::min(thetaD + thetaB, M_PI) <= thetaA) return r.axis = a.axis, r.cosO = a.cosO, r;
+    if (std::min(thetaD + thetaA, M_PI) <= thetaB) return r.axis = b.axis, r.cosO = b.cosO, r;
+
+    const double thetaO = (thetaA + thetaD + thetaB) / 2;
+    Vec k = a.axis % b.axis;
+    if (thetaO >= M_PI || k.dot(k) == 0) {
+        r.cosO = -1;
+        return r;
+    }
+    // a的轴绕k转过thetaO - thetaA
+    k.norm();
+    const double rot = thetaO - thetaA;
+    r.axis = (a.axis * Real(cos(rot)) + (k % a.axis) * Real(sin(rot))).norm();
+    r.cosO = cos(thetaO);
+    return r;
+}
+
+// 方向锥的方向度量（SAOH中的M_Ω）
+double cone_measure(const Cone &c) {
+    const double thetaO = acos(c.cosO), thetaE = acos(c.cosE);
+    const double thetaW = std::min(thetaO + thetaE, M_PI);
+    return 2 * M_PI * (1 - c.cosO) +
+           M_PI / 2 * (2 * thetaW * sin(thetaO) - cos(thetaO - 2 * thetaW) - 2 * thetaO * sin(thetaO) + c.cosO);
+}
+
+struct LightBox {
+    double lo[3] = { 1e300,  1e300,  1e300};
+    double hi[3] = {-1e300, -1e300, -1e300};
+
+    void grow(const LightBox &b) {
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], b.lo[a]);
+            hi[a] = std::max(hi[a], b.hi[a]);
+        }
+    }
+    double area() const {
+        double dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        if (dx < 0 || dy < 0 || dz < 0) return 0;
+        return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+};
+
+struct LightPrim {
+    LightBox box;
+    Cone cone;
+    double c[3];
+    double power;
+    int slot;
+};
+
+struct LightCluster {
+    LightBox box;
+    Cone cone;
+    double power = 0;
+
+    void add(const LightPrim &p) {
+        box.grow(p.box);
+        cone = merge(cone, p.cone);
+        power += p.power;
+    }
+    void add(const LightCluster &o) {
+        box.grow(o.box);
+        cone = merge(cone, o.cone);
+        power += o.power;
+    }
+    // 表面积-朝向启发式（SAOH）的代价
+    double cost() const {return power * box.area() * cone_measure(cone);}
+};
+
+struct LightBuilder {
+    std::vector<LightPrim> prims;
+    std::vector<LightNode> &nodes;
+    std::vector<int> &leafOf;
+
+    LightBuilder(std::vector<LightNode> &n, std::vector<int> &l) : nodes(n), leafOf(l) {}
+
+    void store(int nodeIdx, const LightCluster &c) {
+        LightNode &node = nodes[nodeIdx];
+        for (int a = 0; a < 3; ++a) {
+            node.bmin[a] = (float)c.box.lo[a];
+            node.bmax[a] = (float)c.box.hi[a];
+        }
+        node.axis[0] = (float)c.cone.axis.x;
+        node.axis[1] = (float)c.cone.axis.y;
+        node.axis[2] = (float)c.cone.axis.z;
+        node.cosThetaO = (float)c.cone.cosO;
+        node.cosThetaE = (float)c.cone.cosE;
+        node.power = (float)c.power;
+    }
+
+    int build(int begin, int end, int parent) {
+        const int nodeIdx = (int)nodes.size();
+        nodes.push_back(LightNode());
+        nodes[nodeIdx].parent = parent;
+
+        LightCluster all;
+        double clo[3] = {1e300, 1e300, 1e300}, chi[3] = {-1e300, -1e300, -1e300};
+        for (int i = begin; i < end; ++i) {
+            all.add(prims[i]);
+            for (int a = 0; a < 3; ++a) {
+                clo[a] = std::min(clo[a], prims[i].c[a]);
+                chi[a] = std::max(chi[a], prims[i].c[a]);
+            }
+        }
+        store(nodeIdx, all);
+
+        // 每个叶子只放一个光源，便于按光源反查抽样概率
+        if (end - begin == 1) {
+            nodes[nodeIdx].leaf = 1;
+            nodes[nodeIdx].offset = prims[begin].slot;
+            leafOf[prims[begin].slot] = nodeIdx;
+            return nodeIdx;
+        }
+
+        // 分桶SAOH：在三个轴上寻找代价最小的划分
+        double bestCost = 1e300;
+        int bestAxis = -1, bestSplit = 0;
+        for (int a = 0; a < 3; ++a) {
+            const double extent = chi[a] - clo[a];
+            if (extent <= 0) continue;
+            LightCluster bins[NUM_BINS];
+            for (int i = begin; i < end; ++i)
+                bins[std::min(NUM_BINS - 1, (int)(NUM_BINS * (prims[i].c[a] - clo[a]) / extent))].add(prims[i]);
+
+            for (int s = 1; s < NUM_BINS; ++s) {
+                LightCluster left, right;
+                for (int b = 0; b < s; ++b) left.add(bins[b]);
+                for (int b = s; b < NUM_BINS; ++b) right.add(bins[b]);
+                if (left.cone.empty || right.cone.empty) continue;
+                const double cost = left.cost() + right.cost();
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = a;
+                    bestSplit = s;
+                }
+            }
+        }
+
+        int mid;
+        if (bestAxis >= 0) {
+            const double lo = clo[bestAxis], extent = chi[bestAxis] - lo;
+            LightPrim* m = std::partition(&prims[begin], &prims[begin] + (end - begin), [&](const LightPrim &p) {
+                return std::min(NUM_BINS - 1, (int)(NUM_BINS * (p.c[bestAxis] - lo) / extent)) < bestSplit;
+            });
+            mid = (int)(m - &prims[0]);
+        } else {
+            mid = (begin + end) / 2; // 中心全部重合，按数量对半分
+        }
+
+        nodes[nodeIdx].leaf = 0;
+        build(begin, mid, nodeIdx);
+        nodes[nodeIdx].offset = build(mid, end, nodeIdx);
+        return nodeIdx;
+    }
+};
+
+// cos(max(0, a - b))
+inline Real cos_sub_clamped(Real sinA, Real cosA, Real sinB, Real cosB) {
+    return cosA > cosB ? 1 : cosA * cosB + sinA * sinB;
+}
+
+}
+
+void LightBVH::build(const Sphere* spheres, const int* lights, int n) {
+    nodes.clear();
+    leafOf.assign(n, -1);
+    if (n == 0) return;
+
+    LightBuilder builder(nodes, leafOf);
+    builder.prims.resize(n);
+    for (int i = 0; i < n; ++i) {
+        const Sphere &s = spheres[lights[i]];
+        LightPrim &p = builder.prims[i];
+        const double c[3] = {s.p.x, s.p.y, s.p.z};
+        for (int a = 0; a < 3; ++a) {
+            p.box.lo[a] = c[a] - s.rad;
+            p.box.hi[a] = c[a] + s.rad;
+            p.c[a] = c[a];
+        }
+        // 球面各个方向都有发射面，每个面照亮其法线一侧的半球
+        p.cone.empty = false;
+        p.cone.cosO = -1;
+        p.cone.cosE = 0;
+        p.power = light_power(s);
+        p.slot = i;
+    }
+    nodes.reserve(2 * n - 1);
+    builder.build(0, n, -1);
+}
+
+void LightBVH::clear() {
+    nodes.clear();
+    leafOf.clear();
+}
+
+Real LightBVH::importance(const LightNode &node, const Vec &x, const Vec &nl) const {
+    const Vec lo(node.bmin[0], node.bmin[1], node.bmin[2]);
+    const Vec hi(node.bmax[0], node.bmax[1], node.bmax[2]);
+    const Vec center = (lo + hi) * Real(0.5);
+    const Vec diag = hi - lo;
+    const Real radius2 = diag.dot(diag) * Real(0.25);
+
+    Vec toX = x - center;
+    const Real dist2 = toX.dot(toX);
+    // 距离不小于包围球半径，避免着色点靠近或位于包围盒内时重要性发散
+    const Real d2 = std::max(dist2, radius2);
+
+    // 包围盒相对x所张的圆锥，x在包围球内时覆盖所有方向
+    Real sinB = 0, cosB = -1;
+    if (dist2 > radius2) {
+        const Real sin2 = radius2 / dist2;
+        sinB = sqrt(sin2);
+        cosB = sqrt(1 - sin2);
+    }
+    const Real invDist = dist2 > 0 ? 1 / sqrt(dist2) : 0;
+    toX = toX * invDist;
+
+    // 发射方向锥朝向x的余弦：cos(max(0, θw - θo - θb))
+    Real cosTheta = 1;
+    if (node.cosThetaO > -1) {
+        const Vec axis(node.axis[0], node.axis[1], node.axis[2]);
+        const Real cosW = axis.dot(toX);
+        const Real sinW = sqrt(std::max(Real(0), 1 - cosW*cosW));
+        const Real cosO = node.cosThetaO, sinO = sqrt(std::max(Real(0), 1 - cosO*cosO));
+        const Real cosWO = cos_sub_clamped(sinW, cosW, sinO, cosO);
+        const Real sinWO = cosWO >= 1 ? 0 : sqrt(std::max(Real(0), 1 - cosWO*cosWO));
+        cosTheta = cos_sub_clamped(sinWO, cosWO, sinB, cosB);
+        if (cosTheta <= node.cosThetaE) return 0;
+    }
+
+    // 着色面朝向包围盒的余弦：cos(max(0, θi - θb))，背面为0
+    const Real cosI = -nl.dot(toX);
+    const Real sinI = sqrt(std::max(Real(0), 1 - cosI*cosI));
+    const Real cosIB = cos_sub_clamped(sinI, cosI, sinB, cosB);
+    if (cosIB <= 0) return 0;
+
+    return node.power * cosTheta * cosIB / d2;
+}
+
+int LightBVH::sample(const Vec &x, const Vec &nl, Real u, Real &pmf) const {
+    if (nodes.empty()) return -1;
+    int i = 0;
+    pmf = 1;
+    while (!nodes[i].leaf) {
+        const int left = i + 1, right = nodes[i].offset;
+        const Real il = importance(nodes[left], x, nl), ir = importance(nodes[right], x, nl);
+        if (il + ir <= 0) return -1;
+        const Real pl = il / (il + ir);
+        // 复用u：选中后把u重新映射回[0,1)
+        if (u < pl) {
+            u = std::min(u / pl, ONE_MINUS_EPS);
+            pmf *= pl;
+            i = left;
+        } else {
+            u = std::min((u - pl) / (1 - pl), ONE_MINUS_EPS);
+            pmf *= 1 - pl;
+            i = right;
+        }
+    }
+    return nodes[i].offset;
+}
+
+Real LightBVH::pmf(int slot, const Vec &x, const Vec &nl) const {
+    Real p = 1;
+    for (int i = leafOf[slot]; nodes[i].parent >= 0; i = nodes[i].parent) {
+        const int parent = nodes[i].parent;
+        const Real il = importance(nodes[parent + 1], x, nl);
+        const Real ir = importance(nodes[nodes[parent].offset], x, nl);
+        if (il + ir <= 0) return 0;
+        p *= (i == parent + 1 ? il : ir) / (il + ir);
+    }
+    return p;
+}
\ No newline at end of file
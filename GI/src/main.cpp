@@ -2,9 +2,11 @@
 #include "scene.h"
 #include "render.h"
 #include "camera.h"
+#include "render_thread.h"
 #include "utils.h"
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <stdio.h>
 #include <string.h>
 
 //#pragma omp requires unified_shared_memory
@@ -12,6 +14,7 @@
 // 全局变量声明
 Camera camera(Vec(50, 45, 295.6), Vec(0, -0.042612, -1).norm());
 Display* display;
+RenderThread* renderer;
 bool cameraMoved = false;
 double lastTime = 0;
 
@@ -52,6 +55,26 @@ void processInput(GLFWwindow* window, double deltaTime) {
     }
 
     if (moved) cameraMoved = true;
+
+    // N键切换降噪，按下时只切换一次
+    static bool denoiseKeyDown = false;
+    const bool down = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
+    if (down && !denoiseKeyDown) renderer->set_denoise(!renderer->denoise());
+    denoiseKeyDown = down;
+
+    // T键切换色调映射，-/=键按每秒一档调整曝光
+    static bool toneKeyDown = false;
+    const bool toneDown = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (toneDown && !toneKeyDown) display->toneMapper = (display->toneMapper + 1) % 3;
+    toneKeyDown = toneDown;
+
+    // R键切换动态分辨率
+    static bool dynamicKeyDown = false;
+    const bool dynamicDown = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (dynamicDown && !dynamicKeyDown) renderer->set_dynamic_resolution(!renderer->dynamic_resolution());
+    dynamicKeyDown = dynamicDown;
+    if (glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS) display->exposure *= float(pow(2.0, -deltaTime));
+    if (glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS) display->exposure *= float(pow(2.0, deltaTime));
 }
 
 int main() {
@@ -63,7 +86,7 @@ int main() {
     glfwSetCursorPosCallback(display->window, mouse_callback);
     glfwSetInputMode(display->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    int totalSamples = 0; // 累计采样次数
+    renderer = new RenderThread(display->w, display->h, camera); // 渲染在后台线程进行，主循环只处理输入和显示
     lastTime = glfwGetTime();
 
     // 主循环
@@ -74,24 +97,26 @@ int main() {
 
         processInput(display->window, deltaTime); // 处理输入
 
-        // 相机移动后重置缓冲区和采样计数
+        // 相机移动后投递给渲染线程，正在渲染的一帧随即中止，已累积的结果重投影到新视角
         if (cameraMoved) {
-            memset(display->framebuffer, 0, sizeof(Vec) * display->w * display->h);
-            totalSamples = 0;
+            renderer->set_camera(camera);
             cameraMoved = false;
         }
 
-        // 渲染图像
-        const int SAMPLES_PER_FRAME = 4;
-        render_image(display->framebuffer, display->w, display->h, totalSamples, SAMPLES_PER_FRAME, camera);
-        
-        // 更新纹理并渲染帧
-        display->update_texture(totalSamples);
+        // 有新的一帧时上传纹理，否则继续显示上一帧
+        if (renderer->acquire_frame()) {
+            const FrameSnapshot &frame = renderer->frame();
+            display->update_texture(frame);
+            printf("Rendering %dx%d (1/%d) %.2f samples/pixel (%llu this frame), upload %.2f ms CPU / %.2f ms GPU\n",
+                   frame.w, frame.h, frame.scale, frame.spp, (unsigned long long)frame.traced,
+                   display->uploadCpuMs, display->uploadGpuMs);
+        }
         display->render_frame();
 
         glfwPollEvents(); // 处理事件
     }
 
+    delete renderer; // 先停止渲染线程，再释放场景
     cleanup_scene(); 
     delete display; // 清理资源
     return 0;
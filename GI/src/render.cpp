@@ -2,172 +2,306 @@
 #include "render.h"
 #include "scene.h"
 #include "utils.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "sphere_simd.h"
+#include "shading.h"
+#include "wavefront.h"
 #include <math.h>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <omp.h>
+#include <algorithm>
+#include <vector>
 
 
-// 核心路径追踪函数
-Vec radiance(const Ray &r, int depth, unsigned short *Xi) {
-    double t;                         // 相交距离
-    int id = 0;                       // 相交物体ID
+// 路径状态：当前光线、吞吐量（路径上已累积的反射率权重）、弹射深度和所用的采样器子序列。
+// 漫反射顶点同时做光源采样和材质采样，材质采样光线命中光源时要按MIS加权，
+// 因此记下发出当前光线的顶点prevX、其法线prevNl和材质采样pdf（相机或镜面/折射为0）
+struct PathState {
+    Ray r;
+    Vec throughput;
+    int depth;
+    uint32_t stream;
+    Vec prevX, prevNl;
+    Real bsdfPdf;
+};
+
+// 核心路径追踪函数（迭代实现）
+// REFR在depth<=2时同时追踪反射和折射两条分支，其中一条压入pending稍后处理，
+// 调用栈深度与弹射次数无关，每条路径占用的内存有固定上限。
+// hasFirstHit时第一段光线的交点(firstT, firstId)已由包追踪求出，不再重复求交。
+// 第k次弹射使用bounce_dim(k, ·)维度；分支出的反射路径改用子序列，编号规则与wavefront相同
+static Vec trace_path(const Ray &r, int depth, Sampler &cameraSampler, bool hasFirstHit, Real firstT, int firstId) {
+    const int MAX_PENDING = 4;        // 分支只发生在前两次弹射，最多同时挂起2条
+    PathState pending[MAX_PENDING];
+    int numPending = 0;
+    Vec L;                            // 累积的辐射亮度
 
     if (depth < 0) {
         return Vec(); // 返回黑色防止崩溃
     }
+    pending[numPending++] = {r, Vec(1, 1, 1), depth, 0, Vec(), Vec(), 0};
 
-    // 场景相交检测
-    if (!scene_intersect(r, t, id)) 
-        return Vec(); // 未命中返回黑色
-    
-    const Sphere &obj = spheres[id];  // 获取相交物体
-    Vec x = r.o + r.d * t;            // 交点坐标
-    Vec n = (x - obj.p).norm();       // 法线向量
-    Vec nl = n.dot(r.d) < 0 ? n : n * -1; // 确保法线方向正确
-    Vec f = obj.c;                    // 物体颜色
-    
-    // 自发光贡献
-    Vec emitted = (obj.e.x > 0 || obj.e.y > 0 || obj.e.z > 0) ? obj.e : Vec();
-
-    if (depth > 30) return emitted;
-    
-    // 俄罗斯轮盘赌终止条件
-    if (++depth > 8) {  
-        double p = f.x > f.y && f.x > f.z ? f.x : (f.y > f.z ? f.y : f.z);
-        p = std::max(p, 0.1); // 避免过小的概率值
-        if (erand48(Xi) >= p) 
-            return emitted;  // 提前终止返回发光
-        f = f*(1.0/p);       // 补偿能量
-    }
-    
-    // 直接光源采样
-    if (obj.refl == DIFF) {
-        // 遍历所有光源
-        Vec directLight = Vec();
-        for (int i = 0; i < num_spheres; ++i) {
-            if (!(spheres[i].e.x > 0 || spheres[i].e.y > 0 || spheres[i].e.z > 0)) 
-                continue; // 跳过非光源
-            
-            const Sphere &light = spheres[i];
-            Vec lightDir = light.p - x;
-            double lightDist2 = lightDir.dot(lightDir);
-            lightDir = lightDir.norm();
-            
-            // 构建阴影射线
-            Ray shadowRay(x + nl*1e-3, lightDir);
-            double lightDist = sqrt(lightDist2);
-            double t_light;
-            int id_light;
-            
-            // 阴影检测
-            if (!scene_intersect(shadowRay, t_light, id_light) || (t_light*t_light > lightDist2)) {
-                // 计算立体角（光源表面积投影）
-                double cosThetaLight = sqrt(1.0 - (light.rad*light.rad)/lightDist2);
-                if (lightDist2 < light.rad*light.rad) cosThetaLight = 0; 
-                double omega = 2 * M_PI * (1 - cosThetaLight);
-                double cosTheta = nl.dot(lightDir);
-                if (cosTheta > 0) {
-                    Vec brdf = f * (1.0/M_PI);
-                    directLight = directLight + brdf.mult(light.e) * cosTheta * omega;
+    while (numPending > 0) {
+        PathState path = pending[--numPending];
+        Sampler sampler = path.stream ? cameraSampler.substream(path.stream) : cameraSampler;
+
+        while (true) {
+            Real t;                         // 相交距离
+            int id = 0;                       // 相交物体ID
+
+            // 场景相交检测
+            if (hasFirstHit) {
+                hasFirstHit = false;
+                t = firstT;
+                id = firstId;
+                if (id < 0) break;
+            } else if (!scene_intersect(path.r, t, id)) {
+                break; // 未命中为黑色
+            }
+
+            const Ray &ray = path.r;
+            const Sphere &obj = spheres[id];  // 获取相交物体
+            Vec x = madd(ray.d, t, ray.o);    // 交点坐标
+            Vec n = (x - obj.p).norm();       // 法线向量
+            Vec nl = n.dot(ray.d) < 0 ? n : n * -1; // 确保法线方向正确
+            Vec f = obj.c;                    // 物体颜色
+
+            // 自发光贡献
+            Vec emitted = is_emitter(obj) ? obj.e * emission_weight(id, path.prevX, path.prevNl, path.bsdfPdf) : Vec();
+
+            if (path.depth > 30) {
+                GI_STAT(STAT_DEPTH_CUTOFFS);
+                L = madd(path.throughput, emitted, L);
+                break;
+            }
+
+            // 俄罗斯轮盘赌终止条件
+            const int bounce = path.depth++;
+            if (path.depth > 8) {
+                Real p = f.x > f.y && f.x > f.z ? f.x : (f.y > f.z ? f.y : f.z);
+                p = std::max(p, Real(0.1)); // 避免过小的概率值
+                if (sampler.get1D(bounce_dim(bounce, BOUNCE_RR)) >= p) {
+                    GI_STAT(STAT_RR_TERMINATIONS);
+                    L = madd(path.throughput, emitted, L); // 提前终止只计发光
+                    break;
+                }
+                f = f*(1.0/p);       // 补偿能量
+            }
+
+            // 直接光源采样：抽取一个光源，只追踪一条阴影光线
+            if (obj.refl == DIFF) {
+                Real lightPmf, u1, u2;
+                const int light = scene_sample_light(x, nl, sampler.get1D(bounce_dim(bounce, BOUNCE_LIGHT)), lightPmf);
+                sampler.get2D(bounce_dim(bounce, BOUNCE_LIGHT_U), u1, u2);
+
+                Ray shadowRay;
+                Real lightDist;
+                Vec contrib;
+                if (light >= 0 && connect_light(spheres[light], lightPmf, x, nl, f, u1, u2, shadowRay, lightDist, contrib)) {
+                    // 阴影检测
+                    GI_STAT(STAT_SHADOW_RAYS);
+                    if (!scene_occluded(shadowRay, shadow_tmax(lightDist)))
+                        emitted = emitted + contrib;
+                }
+            }
+
+            L = madd(path.throughput, emitted, L);
+            path.throughput = path.throughput.mult(f);
+
+            // 材质处理：生成下一段光线
+            if (obj.refl == DIFF) { // 漫反射
+                Real u1, u2;
+                sampler.get2D(bounce_dim(bounce, BOUNCE_BSDF_U), u1, u2);
+                path.r = Ray(x, sample_diffuse(nl, u1, u2));
+                path.prevX = x;
+                path.prevNl = nl;
+                path.bsdfPdf = diffuse_pdf(nl.dot(path.r.d));
+                GI_STAT(STAT_BSDF_RAYS);
+            } else if (obj.refl == SPEC) { // 镜面反射
+                path.r = Ray(x, reflect(ray.d, n));
+                path.bsdfPdf = 0;
+                GI_STAT(STAT_BSDF_RAYS);
+            } else { // 折射
+                Ray reflRay(x, reflect(ray.d, n));
+                Vec tdir;
+                path.bsdfPdf = 0;
+                Real Re;
+
+                // 全反射处理
+                if (!refract_dielectric(ray.d, n, nl, tdir, Re)) {
+                    GI_STAT(STAT_TIR_EVENTS);
+                    GI_STAT(STAT_BSDF_RAYS);
+                    path.r = reflRay;
+                    continue;
+                }
+                Real Tr = 1 - Re;
+
+                if (path.depth > 2 || numPending == MAX_PENDING) {
+                    // 重要性采样：只选择一条分支
+                    GI_STAT(STAT_BSDF_RAYS);
+                    Real P = 0.25 + 0.5*Re;
+                    if (sampler.get1D(bounce_dim(bounce, BOUNCE_LOBE)) < P) {
+                        path.throughput = path.throughput * (Re/P);
+                        path.r = reflRay;
+                    } else {
+                        path.throughput = path.throughput * (Tr/(1 - P));
+                        path.r = Ray(x, tdir);
+                    }
+                } else {
+                    // 同时追踪两条分支：先继续折射，反射分支挂起
+                    GI_STAT_ADD(STAT_BSDF_RAYS, 2);
+                    const uint32_t childStream = path.stream * 4 + path.depth + 1;
+                    pending[numPending++] = {reflRay, path.throughput * Re, path.depth, childStream, x, nl, 0};
+                    path.throughput = path.throughput * Tr;
+                    path.r = Ray(x, tdir);
                 }
             }
         }
-        emitted = emitted + directLight;
-    }
-    
-    // 材质处理
-    switch (obj.refl) {
-        case DIFF: { // 漫反射
-            double r1 = 2*M_PI*erand48(Xi);
-            double r2 = erand48(Xi);
-            double r2s = sqrt(r2);
-            
-            // 构建局部坐标系
-            Vec w = nl;
-            Vec u = ((fabs(w.x) > 0.1 ? Vec(0,1) : Vec(1))%w).norm();
-            Vec v = w%u;
-            
-            // 余弦权重采样
-            Vec d = (u*cos(r1)*r2s + v*sin(r1)*r2s + w*sqrt(1 - r2)).norm();
-            return emitted + f.mult(radiance(Ray(x, d), depth, Xi));
-        }
-        case SPEC: { // 镜面反射
-            Vec reflDir = r.d - n*2*n.dot(r.d);
-            return emitted + f.mult(radiance(Ray(x, reflDir.norm()), depth, Xi));
-        }
-        case REFR: { // 折射
-            Ray reflRay(x, (r.d - n*2*n.dot(r.d)).norm());
-            bool into = n.dot(nl) > 0;
-            double nc = 1.0, nt = 1.5;
-            double nnt = into ? nc/nt : nt/nc;
-            double ddn = r.d.dot(nl);
-            double cos2t = 1 - nnt*nnt*(1 - ddn*ddn);
-            
-            // 全反射处理
-            if (cos2t < 0) 
-                return emitted + f.mult(radiance(reflRay, depth, Xi));
-            
-            Vec tdir = (r.d*nnt - n*((into?1:-1)*(ddn*nnt + sqrt(cos2t)))).norm();
-            double a = nt - nc, b = nt + nc;
-            double R0 = a*a/(b*b), c = 1 - (into ? -ddn : tdir.dot(n));
-            double Re = R0 + (1 - R0)*c*c*c*c*c;
-            double Tr = 1 - Re;
-            
-            // 重要性采样
-            if (depth > 2) {
-                double P = 0.25 + 0.5*Re;
-                if (erand48(Xi) < P)
-                    return emitted + f.mult(radiance(reflRay, depth, Xi)*(Re/P));
-                else
-                    return emitted + f.mult(radiance(Ray(x, tdir), depth, Xi)*(Tr/(1 - P)));
-             }
-            return emitted + f.mult(
-                radiance(reflRay, depth, Xi)*Re + 
-                radiance(Ray(x, tdir), depth, Xi)*Tr);
-         }
-        default:
-            return emitted;
     }
+    return L;
 }
 
+Vec radiance(const Ray &r, int depth, Sampler &sampler) {
+    return trace_path(r, depth, sampler, false, 0, -1);
+}
+
+Vec radiance(const Ray &r, Real firstT, int firstId, Sampler &sampler) {
+    return trace_path(r, 0, sampler, true, firstT, firstId);
+}
+
+
+Integrator render_integrator = INTEGRATOR_PATH;
+
+CameraFrame::CameraFrame(const Camera &cam, int w_, int h_)
+    : cx(w_ * 0.5135 / h_, 0, 0), origin(cam.position), front(cam.front), w(w_), h(h_) {
+    cy = (cx % cam.front).norm() * 0.5135;
+}
+
+Ray CameraFrame::generate(int x, int y, Sampler &sampler) const {
+    // 生成抗锯齿采样坐标（tent滤波）
+    Real r1, r2;
+    sampler.get2D(DIM_PIXEL_X, r1, r2);
+    r1 *= 2;
+    r2 *= 2;
+    const Real dx = (r1 < 1) ? sqrt(r1)-1 : 1-sqrt(2-r1);
+    const Real dy = (r2 < 1) ? sqrt(r2)-1 : 1-sqrt(2-r2);
+
+    // 计算光线方向
+    Vec rayDir = madd(cx, Real((x + dx/2)/w - 0.5), madd(cy, Real((y + dy/2)/h - 0.5), front)).norm();
+    return Ray(madd(rayDir, Real(140), origin), rayDir);
+}
+
+Ray CameraFrame::center(int x, int y) const {
+    Vec rayDir = madd(cx, Real(Real(x)/w - 0.5), madd(cy, Real(Real(y)/h - 0.5), front)).norm();
+    return Ray(madd(rayDir, Real(140), origin), rayDir);
+}
+
+// 光线方向正比于 cx·a + cy·b + front，其中a = x/w - 0.5、b = y/h - 0.5。
+// cx固定沿世界x轴，与front不一定正交，按克莱姆法则解 [cx cy front]·(a, b, 1)·s = p - origin
+bool CameraFrame::project(const Vec &p, Real &px, Real &py) const {
+    const Vec d = p - origin;
+    const Real det = cx.dot(cy % front);
+    if (fabs(det) < 1e-12) return false;
+    const Real s = cx.dot(cy % d) / det; // front的系数
+    if (s <= 0) return false;
+    const Real a = d.dot(cy % front) / det / s;
+    const Real b = cx.dot(d % front) / det / s;
+    px = (a + 0.5) * w;
+    py = (b + 0.5) * h;
+    return true;
+}
 
 // 渲染函数
-void render_image(Vec* c, int w, int h, int &totalSamples, int addSamples, const Camera& cam) {
-    Vec cx = Vec(w * 0.5135 / h , 0 , 0 );
-    Vec cy = (cx % cam.front).norm() * 0.5135 ;
-    Vec camPos = cam.position;
-
-    printf("Rendering %d samples...\n", totalSamples + addSamples);
-
-    //主渲染循环
-    #pragma omp parallel for schedule(dynamic, 4) collapse(2)
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x){
-            unsigned short Xi[3] = { 
-                static_cast<unsigned short>((x << 8) | y),
-                static_cast<unsigned short>(totalSamples),
-                static_cast<unsigned short>(omp_get_thread_num())  // 增加线程标识
-            };
-            
-            // 生成抗锯齿采样坐标
-            const double r1 = 2 * erand48(Xi);
-            const double r2 = 2 * erand48(Xi);
-            const double dx = (r1 < 1) ? sqrt(r1)-1 : 1-sqrt(2-r1);
-            const double dy = (r2 < 1) ? sqrt(r2)-1 : 1-sqrt(2-r2);
-                
-            // 计算光线方向
-            Vec rayDir = (cx * ((x + dx/2)/w - 0.5) + cy * ((y + dy/2)/h - 0.5) + cam.front).norm();
-                
-            // 路径追踪计算
-            Vec sample = radiance(Ray(camPos + rayDir*140, rayDir.norm()), 0, Xi);
-            
-            c[y*w+x] = c[y*w+x] + sample;
-            //printf("\rPixel (\t%d, \t%d): (%f, %f, %f)", x, y, pixelColor.x, pixelColor.y, pixelColor.z);
+
+// 相机光线按PACKET_DIM×PACKET_DIM的像素块打包求交，之后的弹射逐条追踪
+const int PACKET_DIM = 8;
+static_assert(PACKET_DIM * PACKET_DIM == PACKET_SIZE, "packet block must fill a RayPacket");
+
+uint64_t render_image(Film &film, int addSamples, const Camera& cam, const std::atomic<bool> *cancel) {
+    const int w = film.w, h = film.h;
+    const CameraFrame frame(cam, w, h);
+    TileScheduler &scheduler = film.scheduler;
+
+    //主渲染循环：按tile调度，每个采样的随机流由(像素编号, 该像素的采样序号)决定，与线程调度无关
+    const int numThreads = omp_get_max_threads();
+    bool aborted = false;
+    scheduler.begin_frame(w, h, numThreads);
+    stats_begin_frame(numThreads);
+    #pragma omp parallel
+    {
+        const int thread = omp_get_thread_num();
+        stats_thread_begin();
+        uint32_t pixels[TileScheduler::TILE_SIZE * TileScheduler::TILE_SIZE];
+        uint32_t samples[PACKET_SIZE];
+        uint32_t firstBlocks[PACKET_SIZE * 4];
+        RayPacket packet;
+        Ray rays[PACKET_SIZE];
+        std::vector<Sampler> samplers;
+        samplers.reserve(PACKET_SIZE);
+        Wavefront wavefront;
+        int index;
+
+        while ((index = scheduler.next(thread)) >= 0) {
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                #pragma omp atomic write
+                aborted = true;
+                break;
+            }
+            const Tile &tile = scheduler.tile(index);
+            const double start = omp_get_wtime();
+
+            // 每一轮给tile内的每个像素各追加一个采样
+            for (int pass = 0; pass < addSamples; ++pass) {
+                if (render_integrator == INTEGRATOR_WAVEFRONT) {
+                    int n = 0;
+                    for (int y = tile.y0; y < tile.y1; ++y)
+                        for (int x = tile.x0; x < tile.x1; ++x)
+                            pixels[n++] = y*w + x;
+                    wavefront.trace(pixels, n, frame, film);
+                    continue;
+                }
+
+                for (int by = tile.y0; by < tile.y1; by += PACKET_DIM)
+                for (int bx = tile.x0; bx < tile.x1; bx += PACKET_DIM) {
+                    int n = 0;
+                    for (int y = by; y < std::min(by + PACKET_DIM, tile.y1); ++y)
+                        for (int x = bx; x < std::min(bx + PACKET_DIM, tile.x1); ++x)
+                            pixels[n++] = y*w + x;
+
+                    // 随机采样器下整块像素的前4个维度一次批量生成
+                    for (int i = 0; i < n; ++i) samples[i] = film.next[pixels[i]];
+                    const bool batch = render_sampler == SAMPLER_RANDOM;
+                    if (batch) philox_first_block_batch(pixels, samples, n, firstBlocks);
+
+                    packet.count = 0;
+                    samplers.clear();
+                    for (int i = 0; i < n; ++i) {
+                        if (batch) samplers.emplace_back(pixels[i], samples[i], &firstBlocks[i * 4]);
+                        else samplers.emplace_back(pixels[i], samples[i]);
+                        rays[i] = frame.generate(pixels[i] % w, pixels[i] / w, samplers.back());
+                        packet.add(rays[i]);
+                    }
+
+                    // 整包求出相机光线的首个交点
+                    GI_STAT_ADD(STAT_CAMERA_RAYS, n);
+                    scene_intersect_packet(packet);
+
+                    // 路径追踪计算
+                    for (int i = 0; i < n; ++i)
+                        film.add_sample(pixels[i], radiance(rays[i], packet.t[i], packet.id[i], samplers[i]),
+                                        hit_features(rays[i], packet.t[i], packet.id[i]));
+                }
+            }
+            scheduler.record(index, omp_get_wtime() - start);
         }
+        stats_thread_end(thread);
+    }
+    stats_end_frame();
+    if (aborted) {
+        scheduler.discard_frame();
+        return 0;
     }
-    
-    // 更新总采样数
-    #pragma omp atomic
-    totalSamples += addSamples;
+    return uint64_t(w) * h * addSamples;
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "render_thread.h"
+#include <algorithm>
+#include <chrono>
+
+RenderThread::RenderThread(int w_, int h_, const Camera &cam) : w(w_), h(h_), camera(cam) {
+    for (int l = 0; l < LEVELS; ++l)
+        levels[l].film.resize(std::max(w >> l, 1), std::max(h >> l, 1));
+    worker = std::thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread() {
+    stopping.store(true);
+    cancel.store(true);
+    worker.join();
+}
+
+// 先发布相机再置位cancel：渲染线程在取相机之前清除cancel，
+// 两者交错时最多多中止一帧，不会漏掉新相机，也不会一直处于取消状态
+void RenderThread::set_camera(const Camera &cam) {
+    cameras.write_buffer() = cam;
+    cameras.publish();
+    cancel.store(true, std::memory_order_release);
+}
+
+// 预计耗时不超过TARGET_FRAME_MS的最高分辨率；还没有测量时先用最低分辨率
+int RenderThread::choose_level() const {
+    if (secondsPerPixel <= 0) return LEVELS - 1;
+    for (int l = 0; l < LEVELS - 1; ++l) {
+        const Film &film = levels[l].film;
+        if (double(film.w) * film.h * secondsPerPixel * 1e3 <= TARGET_FRAME_MS) return l;
+    }
+    return LEVELS - 1;
+}
+
+void RenderThread::run() {
+    using clock = std::chrono::steady_clock;
+    clock::time_point lastMove = clock::now() - std::chrono::seconds(1);
+
+    while (!stopping.load()) {
+        cancel.store(false, std::memory_order_relaxed);
+        bool moved = false;
+        if (cameras.acquire()) {
+            camera = cameras.read_buffer();
+            lastMove = clock::now();
+            moved = true;
+            for (Level &l : levels) l.stale = true;
+        }
+
+        // 相机最近移动过时按测得的耗时降低分辨率，停止后回到全分辨率
+        const bool moving = dynamicOn.load(std::memory_order_relaxed) &&
+                            std::chrono::duration<double, std::milli>(clock::now() - lastMove).count() < SETTLE_MS;
+        const int level = moving ? choose_level() : 0;
+        Level &lv = levels[level];
+        const auto start = clock::now();
+        if (lv.stale) {
+            lv.reprojection.update(lv.film, camera); // 已累积的结果重投影到新视角，新露出的区域从零开始累积
+            lv.stale = false;
+        }
+
+        const uint64_t traced = render_image(lv.film, SAMPLES_PER_FRAME, camera, moving ? nullptr : &cancel);
+        const double perPixel = std::chrono::duration<double>(clock::now() - start).count() / (lv.film.w * lv.film.h);
+        if (cancel.load(std::memory_order_acquire) && !moving) {
+            // 中止的一帧耗时不完整，只能说明实际耗时至少这么多
+            if (moved) secondsPerPixel = std::max(secondsPerPixel, perPixel);
+            continue; // 新相机已到，这一帧不再发布
+        }
+        if (moved) secondsPerPixel = secondsPerPixel > 0 ? secondsPerPixel * 0.8 + perPixel * 0.2 : perPixel;
+
+        publish(level, traced, denoiseOn.load(std::memory_order_relaxed));
+    }
+}
+
+void RenderThread::publish(int level, uint64_t traced, bool dn) {
+    const Film &film = levels[level].film;
+    const int n = film.w * film.h;
+    FrameSnapshot &f = frames.write_buffer();
+    f.w = film.w;
+    f.h = film.h;
+    f.scale = 1 << level;
+    f.rgb.resize(n * 3);
+    f.spp = double(film.total_samples()) / n;
+    f.traced = traced;
+
+    if (dn) denoiser.run(film, denoised);
+    #pragma omp parallel for
+    for (int i = 0; i < n; ++i) {
+        const Vec c = dn ? denoised[i] : film.mean(i);
+        f.rgb[i*3]   = float(c.x);
+        f.rgb[i*3+1] = float(c.y);
+        f.rgb[i*3+2] = float(c.z);
+    }
+    frames.publish();
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "reprojection.h"
+#include "scene.h"
+#include "sphere_simd.h"
+#include <math.h>
+#include <algorithm>
+
+void GBuffer::build(const CameraFrame &frame) {
+    w = frame.w;
+    h = frame.h;
+    position.resize(w * h);
+    normal.resize(w * h);
+    id.resize(w * h);
+    depth.resize(w * h);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int y = 0; y < h; ++y) {
+        RayPacket packet;
+        Ray rays[PACKET_SIZE];
+        for (int x0 = 0; x0 < w; x0 += PACKET_SIZE) {
+            const int n = std::min(PACKET_SIZE, w - x0);
+            packet.count = 0;
+            for (int k = 0; k < n; ++k) {
+                rays[k] = frame.center(x0 + k, y);
+                packet.add(rays[k]);
+            }
+            scene_intersect_packet(packet);
+            for (int k = 0; k < n; ++k) {
+                const int i = y*w + x0 + k;
+                id[i] = packet.id[k];
+                if (id[i] < 0) continue;
+                const Vec x = madd(rays[k].d, Real(packet.t[k]), rays[k].o);
+                const Vec nrm = (x - spheres[id[i]].p).norm();
+                position[i] = x;
+                depth[i] = packet.t[k];
+                normal[i] = nrm.dot(rays[k].d) < 0 ? nrm : nrm * -1;
+            }
+        }
+    }
+}
+
+int TemporalReprojection::update(Film &film, const Camera &cam) {
+    const CameraFrame frame(cam, film.w, film.h);
+    cur.build(frame);
+    const bool reuse = valid && prev.w == film.w && prev.h == film.h;
+    int reused = 0;
+
+    if (!reuse) {
+        film.clear();
+    } else {
+        const CameraFrame prevFrame(prevCamera, prev.w, prev.h);
+        const int w = film.w, h = film.h;
+        sum.assign(w * h, Vec());
+        sumSq.assign(w * h, 0.0);
+        count.assign(w * h, 0);
+        albedo.assign(w * h, Vec());
+        normal.assign(w * h, Vec());
+        depth.assign(w * h, 0.0f);
+
+        #pragma omp parallel for schedule(dynamic) reduction(+:reused)
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                const int i = y*w + x;
+                const int id = cur.id[i];
+                if (id < 0 || spheres[id].refl != DIFF) continue;
+                const Vec &p = cur.position[i];
+                const Vec &n = cur.normal[i];
+                Real px, py;
+                if (!prevFrame.project(p, px, py)) continue;
+
+                const Real tolerance = planeThreshold * sqrt((p - frame.origin).dot(p - frame.origin));
+                const int x0 = (int)floor(px), y0 = (int)floor(py);
+                const Real fx = px - x0, fy = py - y0;
+                Vec m, ma, mn;
+                double sq = 0, c = 0;
+                Real weight = 0;
+                for (int k = 0; k < 4; ++k) {
+                    const int tx = x0 + (k & 1), ty = y0 + (k >> 1);
+                    if (tx < 0 || ty < 0 || tx >= w || ty >= h) continue;
+                    const int j = ty*w + tx;
+                    if (prev.id[j] != id || film.count[j] == 0) continue;
+                    if (prev.normal[j].dot(n) < normalThreshold) continue;
+                    if (fabs((prev.position[j] - p).dot(n)) > tolerance) continue;
+
+                    const Real wk = ((k & 1) ? fx : 1 - fx) * ((k >> 1) ? fy : 1 - fy);
+                    const Real inv = Real(1) / film.count[j];
+                    m = madd(film.sum[j], wk * inv, m);
+                    ma = madd(film.albedo[j], wk * inv, ma);
+                    mn = madd(film.normal[j], wk * inv, mn);
+                    sq += wk * inv * film.sumSq[j];
+                    c += wk * film.count[j];
+                    weight += wk;
+                }
+                if (weight < Real(1e-3)) continue;
+
+                // 按有效权重归一化后，得到每个采样的平均值和折算的采样数
+                const uint32_t samples = (uint32_t)std::min<double>(maxHistory, floor(c / weight + 0.5));
+                if (samples == 0) continue;
+                const Real scale = samples / weight;
+                sum[i] = m * scale;
+                sumSq[i] = sq * scale;
+                albedo[i] = ma * scale;
+                normal[i] = mn * scale;
+                depth[i] = cur.depth[i] * samples;
+                count[i] = samples;
+                ++reused;
+            }
+        }
+        film.sum.swap(sum);
+        film.sumSq.swap(sumSq);
+        film.count.swap(count);
+        film.albedo.swap(albedo);
+        film.normal.swap(normal);
+        film.depth.swap(depth);
+    }
+
+    std::swap(prev, cur);
+    prevCamera = cam;
+    valid = true;
+    return reused;
+}
\ No newline at end of file
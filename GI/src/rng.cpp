@@ -0,0 +1,51 @@
+#include "rng.h"
+#include <immintrin.h>
+
+#ifdef __AVX2__
+// 8个32位lane同时乘法，返回高32位和低32位
+static inline void mulhilo8(__m256i a, uint32_t m, __m256i &hi, __m256i &lo) {
+    const __m256i mv = _mm256_set1_epi32((int)m);
+    __m256i even = _mm256_mul_epu32(a, mv);                          // lane 0,2,4,6 的64位乘积
+    __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), mv);   // lane 1,3,5,7 的64位乘积
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    lo = _mm256_mullo_epi32(a, mv);
+}
+#endif
+
+void philox_first_block_batch(const uint32_t* pixels, const uint32_t* samples, int n, uint32_t* out) {
+    int i = 0;
+#ifdef __AVX2__
+    for (; i + 8 <= n; i += 8) {
+        // 计数器为0（第0组维度），密钥为(像素编号, 采样序号)
+        __m256i c0 = _mm256_setzero_si256(), c1 = c0, c2 = c0, c3 = c0;
+        __m256i k0 = _mm256_loadu_si256((const __m256i*)(pixels + i));
+        __m256i k1 = _mm256_loadu_si256((const __m256i*)(samples + i));
+        const __m256i w0 = _mm256_set1_epi32((int)PHILOX_W0), w1 = _mm256_set1_epi32((int)PHILOX_W1);
+        for (int round = 0; round < 10; ++round) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhilo8(c0, PHILOX_M0, hi0, lo0);
+            mulhilo8(c2, PHILOX_M1, hi1, lo1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+            c1 = lo1;
+            c3 = lo0;
+            k0 = _mm256_add_epi32(k0, w0);
+            k1 = _mm256_add_epi32(k1, w1);
+        }
+
+        // 转置为按像素连续存放
+        alignas(32) uint32_t lanes[4][8];
+        _mm256_store_si256((__m256i*)lanes[0], c0);
+        _mm256_store_si256((__m256i*)lanes[1], c1);
+        _mm256_store_si256((__m256i*)lanes[2], c2);
+        _mm256_store_si256((__m256i*)lanes[3], c3);
+        for (int l = 0; l < 8; ++l)
+            for (int d = 0; d < 4; ++d) out[(i + l) * 4 + d] = lanes[d][l];
+    }
+#endif
+    for (; i < n; ++i) {
+        uint32_t* block = out + i * 4;
+        block[0] = block[1] = block[2] = block[3] = 0;
+        philox4x32(block, pixels[i], samples[i]);
+    }
+}
@@ -0,0 +1,62 @@
+#include "sampler.h"
+
+SamplerType render_sampler = SAMPLER_SOBOL;
+
+static inline uint32_t reverse_bits(uint32_t x) {
+    x = __builtin_bswap32(x);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+static inline uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x21f0aaadu;
+    x ^= x >> 15;
+    x *= 0xd35a2d97u;
+    x ^= x >> 15;
+    return x;
+}
+
+static inline uint32_t hash_combine(uint32_t seed, uint32_t v) {
+    return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+// Laine-Karras置换：只让低位影响高位，作用在反转后的位上即为Owen扰乱
+static inline uint32_t laine_karras(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+// Sobol第1维的生成矩阵是模2的Pascal矩阵：由Lucas定理，序号第j位影响结果第i位（按反转位序）当且仅当i是j的子集，
+// 按位做5次超集异或即可，不必逐位循环。返回值仍是反转位序
+static inline uint32_t sobol_dim1_reversed(uint32_t index) {
+    index ^= (index & 0xaaaaaaaau) >> 1;
+    index ^= (index & 0xccccccccu) >> 2;
+    index ^= (index & 0xf0f0f0f0u) >> 4;
+    index ^= (index & 0xff00ff00u) >> 8;
+    index ^= (index & 0xffff0000u) >> 16;
+    return index;
+}
+
+uint32_t sample_seed(uint32_t pixel, uint32_t stream, uint32_t dim) {
+    return hash(hash_combine(hash_combine(hash(pixel), stream), dim));
+}
+
+// 嵌套均匀扰乱（Owen扰乱）为reverse(LK(reverse(x)))。Sobol两维的值都是反转位序的形式，
+// 扰乱时相邻的两次反转抵消，每个值只需进出各反转一次
+void sobol_owen_2d(uint32_t index, uint32_t seed, uint32_t &u, uint32_t &v) {
+    index = reverse_bits(laine_karras(reverse_bits(index), seed)); // 打乱采样顺序
+    u = reverse_bits(laine_karras(index, hash_combine(seed, 0)));
+    v = reverse_bits(laine_karras(sobol_dim1_reversed(index), hash_combine(seed, 1)));
+}
+
+uint32_t sobol_owen_1d(uint32_t index, uint32_t seed) {
+    index = reverse_bits(laine_karras(reverse_bits(index), seed));
+    return reverse_bits(laine_karras(index, hash_combine(seed, 0)));
+}
\ No newline at end of file
@@ -1,8 +1,19 @@
 #include "scene.h"
+#include "bvh.h"
+#include "light.h"
+#include "shading.h"
+#include "stats.h"
 #include <vector>
 
 Sphere* spheres = nullptr; // 动态初始化
 int num_spheres = 0;
+int* emitters = nullptr;
+int num_emitters = 0;
+static BVH scene_bvh;      // 场景加速结构
+static AliasTable light_table;        // 按功率选择光源
+static LightBVH light_bvh;            // 按重要性选择光源
+LightSelection light_selection = LIGHT_SELECT_BVH;
+static std::vector<int> light_slot;   // 物体下标 -> emitters中的位置，非光源为-1
 
 void init_scene() {
     std::vector<Sphere> scene_spheres = {
@@ -19,27 +30,66 @@ void init_scene() {
     num_spheres = scene_spheres.size();
     spheres = new Sphere[num_spheres];
     std::copy(scene_spheres.begin(), scene_spheres.end(), spheres);
-}
+    scene_bvh.build(spheres, num_spheres);
 
-bool scene_intersect(const Ray &r, double &t, int &id) {
-    const float epsilon = 1e-4f;
-    float inf = t = 1e20f;
-    int tempId = -1;
-    
-    #pragma omp simd
-    for (int i = 0; i < num_spheres; i++) {
-        const float d = spheres[i].intersect(r);
-        if (d > epsilon && d < t) {
-            t = d;
-            tempId = i;
-        }
+    // 光源列表和按功率抽样的别名表
+    std::vector<int> lights;
+    std::vector<double> power;
+    light_slot.assign(num_spheres, -1);
+    for (int i = 0; i < num_spheres; ++i) {
+        if (!is_emitter(spheres[i])) continue;
+        light_slot[i] = (int)lights.size();
+        lights.push_back(i);
+        power.push_back(light_power(spheres[i]));
     }
-    
-    id = tempId;
-    return (tempId != -1);
+    num_emitters = lights.size();
+    emitters = new int[num_emitters];
+    std::copy(lights.begin(), lights.end(), emitters);
+    light_table.build(power);
+    light_bvh.build(spheres, emitters, num_emitters);
+}
+
+bool scene_intersect(const Ray &r, Real &t, int &id) {
+    GI_STAT(STAT_SCENE_QUERIES);
+    return scene_bvh.intersect(r, t, id);
+}
+
+void scene_intersect_packet(RayPacket &p) {
+    GI_STAT_ADD(STAT_SCENE_QUERIES, p.count);
+    scene_bvh.intersect_packet(p);
+}
+
+bool scene_occluded(const Ray &r, Real tmax) {
+    GI_STAT(STAT_OCCLUSION_QUERIES);
+    return scene_bvh.occluded(r, tmax);
+}
+
+void scene_occluded_packet(RayPacket &p) {
+    GI_STAT_ADD(STAT_OCCLUSION_QUERIES, p.count);
+    scene_bvh.occluded_packet(p);
+}
+
+int scene_sample_light(const Vec &x, const Vec &nl, Real u, Real &pmf) {
+    if (num_emitters == 0) return -1;
+    if (light_selection == LIGHT_SELECT_POWER) return emitters[light_table.sample(u, pmf)];
+    const int slot = light_bvh.sample(x, nl, u, pmf);
+    return slot < 0 ? -1 : emitters[slot];
+}
+
+Real scene_light_pmf(int id, const Vec &x, const Vec &nl) {
+    const int slot = light_slot[id];
+    if (slot < 0) return 0;
+    return light_selection == LIGHT_SELECT_POWER ? light_table.pmf(slot) : light_bvh.pmf(slot, x, nl);
 }
 
 void cleanup_scene() {
+    scene_bvh.clear();
+    light_table.clear();
+    light_bvh.clear();
+    light_slot.clear();
+    delete[] emitters;
+    emitters = nullptr;
+    num_emitters = 0;
     delete[] spheres;
     spheres = nullptr;
     num_spheres = 0;
@@ -0,0 +1,156 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <utility>
+
+// 耗时超过平均值这么多倍的基础tile会被继续细分
+static const double SPLIT_RATIO = 2.0;
+
+// 把x、y的低16位交错成Morton码
+static uint32_t morton2d(uint32_t x, uint32_t y) {
+    auto spread = [](uint32_t v) {
+        v &= 0xFFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+static uint64_t pack_range(uint32_t begin, uint32_t end) {
+    return (uint64_t)begin << 32 | end;
+}
+
+void TileScheduler::begin_frame(int w, int h, int numThreads) {
+    if (w != width || h != height) {
+        width = w;
+        height = h;
+        cellsX = (w + TILE_SIZE - 1) / TILE_SIZE;
+        cellsY = (h + TILE_SIZE - 1) / TILE_SIZE;
+        cellCost.clear();
+    } else if (!tiles.empty()) {
+        // 汇总上一帧各tile的耗时
+        cellCost.assign(cellsX * cellsY, 0.0);
+        for (size_t i = 0; i < tiles.size(); ++i)
+            cellCost[tiles[i].cell] += tileCost[i];
+    }
+
+    // 基础tile按Morton顺序排列
+    std::vector<std::pair<uint32_t, int>> order;
+    order.reserve(cellsX * cellsY);
+    for (int cy = 0; cy < cellsY; ++cy)
+        for (int cx = 0; cx < cellsX; ++cx)
+            order.push_back({morton2d(cx, cy), cy * cellsX + cx});
+    std::sort(order.begin(), order.end());
+
+    double limit = 0;
+    if (!cellCost.empty()) {
+        double total = 0;
+        for (double c : cellCost) total += c;
+        limit = SPLIT_RATIO * total / cellCost.size();
+    }
+
+    tiles.clear();
+    for (const auto &o : order) {
+        int cell = o.second;
+        int x0 = (cell % cellsX) * TILE_SIZE, y0 = (cell / cellsX) * TILE_SIZE;
+        Tile t = {x0, y0, std::min(x0 + TILE_SIZE, w), std::min(y0 + TILE_SIZE, h), cell};
+        split(t, cellCost.empty() ? 0 : cellCost[cell], limit);
+    }
+    tileCost.assign(tiles.size(), 0.0);
+
+    // 估计每个tile的耗时：有历史时按所属基础tile的耗时和面积比例分摊，否则按面积
+    std::vector<double> estimate(tiles.size());
+    double total = 0;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        const Tile &t = tiles[i];
+        double area = double(t.x1 - t.x0) * (t.y1 - t.y0);
+        if (!cellCost.empty()) {
+            int cx0 = (t.cell % cellsX) * TILE_SIZE, cy0 = (t.cell / cellsX) * TILE_SIZE;
+            double cellArea = double(std::min(cx0 + TILE_SIZE, w) - cx0) * (std::min(cy0 + TILE_SIZE, h) - cy0);
+            estimate[i] = cellCost[t.cell] * area / cellArea;
+        } else {
+            estimate[i] = area;
+        }
+        total += estimate[i];
+    }
+
+    if (numThreads != numQueues) {
+        queues.reset(new WorkRange[numThreads]);
+        numQueues = numThreads;
+    }
+
+    // 按累计耗时把tile序列切成numThreads段连续区间
+    size_t begin = 0;
+    double prefix = 0;
+    for (int q = 0; q < numQueues; ++q) {
+        double target = total * (q + 1) / numQueues;
+        size_t end = begin;
+        while (end < tiles.size() && (q == numQueues - 1 || prefix + estimate[end] * 0.5 <= target))
+            prefix += estimate[end++];
+        queues[q].range.store(pack_range((uint32_t)begin, (uint32_t)end), std::memory_order_relaxed);
+        begin = end;
+    }
+}
+
+// 耗时超过limit的tile四分，子tile仍按Morton顺序（左上、右上、左下、右下）追加
+void TileScheduler::split(const Tile &t, double cost, double limit) {
+    const int tw = t.x1 - t.x0, th = t.y1 - t.y0;
+    const bool splitX = tw > MIN_TILE_SIZE, splitY = th > MIN_TILE_SIZE;
+    if (cost <= limit || (!splitX && !splitY)) {
+        tiles.push_back(t);
+        return;
+    }
+
+    const int xm = splitX ? t.x0 + tw / 2 : t.x1;
+    const int ym = splitY ? t.y0 + th / 2 : t.y1;
+    const int parts = (splitX ? 2 : 1) * (splitY ? 2 : 1);
+    const Tile quads[4] = {
+        {t.x0, t.y0, xm, ym, t.cell}, {xm, t.y0, t.x1, ym, t.cell},
+        {t.x0, ym, xm, t.y1, t.cell}, {xm, ym, t.x1, t.y1, t.cell},
+    };
+    for (const Tile &q : quads) {
+        if (q.x0 < q.x1 && q.y0 < q.y1)
+            split(q, cost / parts, limit);
+    }
+}
+
+int TileScheduler::next(int thread) {
+    if (thread < numQueues) {
+        std::atomic<uint64_t> &q = queues[thread].range;
+        uint64_t r = q.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t b = (uint32_t)(r >> 32), e = (uint32_t)r;
+            if (b >= e) break;
+            if (q.compare_exchange_weak(r, pack_range(b + 1, e), std::memory_order_acq_rel))
+                return (int)b;
+        }
+    }
+
+    int index;
+    return steal(thread, index) ? index : -1;
+}
+
+// 从其他线程的区间尾部偷走一半：返回其中第一个，其余放进自己的区间。
+// 整个过程中不产生新的tile，所以所有区间都为空时就可以结束
+bool TileScheduler::steal(int thread, int &index) {
+    for (int k = 1; k <= numQueues; ++k) {
+        const int victim = (thread + k) % numQueues;
+        std::atomic<uint64_t> &q = queues[victim].range;
+        uint64_t r = q.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t b = (uint32_t)(r >> 32), e = (uint32_t)r;
+            if (b >= e) break;
+            // 没有自己区间的线程只取一个
+            uint32_t mid = thread < numQueues ? e - (e - b + 1) / 2 : e - 1;
+            if (q.compare_exchange_weak(r, pack_range(b, mid), std::memory_order_acq_rel)) {
+                index = (int)mid;
+                if (mid + 1 < e)
+                    queues[thread].range.store(pack_range(mid + 1, e), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "sphere_simd.h"
+
+SphereSoA::~SphereSoA() {
+    clear();
+}
+
+void SphereSoA::resize(int n) {
+    clear();
+    size = (n + SPHERE_LANES - 1) / SPHERE_LANES * SPHERE_LANES;
+    if (size == 0) return;
+
+    cx = (float*)_mm_malloc(sizeof(float) * size, 64);
+    cy = (float*)_mm_malloc(sizeof(float) * size, 64);
+    cz = (float*)_mm_malloc(sizeof(float) * size, 64);
+    r2 = (float*)_mm_malloc(sizeof(float) * size, 64);
+    k  = (float*)_mm_malloc(sizeof(float) * size, 64);
+    ids = (int*)_mm_malloc(sizeof(int) * size, 64);
+    for (int i = 0; i < size; ++i) set_empty(i);
+}
+
+void SphereSoA::set(int slot, const Sphere &s, int id) {
+    cx[slot] = (float)s.p.x;
+    cy[slot] = (float)s.p.y;
+    cz[slot] = (float)s.p.z;
+    r2[slot] = (float)((double)s.rad * s.rad);
+    // float构建下也用double计算k，否则会抵消掉大球的有效位
+    double px = s.p.x, py = s.p.y, pz = s.p.z, rad = s.rad;
+    k[slot]  = (float)(px*px + py*py + pz*pz - rad*rad);
+    ids[slot] = id;
+}
+
+void SphereSoA::set_empty(int slot) {
+    cx[slot] = cy[slot] = cz[slot] = 0;
+    r2[slot] = -1e30f; // C为极大正数，disc = b² - C 恒为负
+    k[slot] = 1e30f;
+    ids[slot] = -1;
+}
+
+void SphereSoA::clear() {
+    _mm_free(cx);
+    _mm_free(cy);
+    _mm_free(cz);
+    _mm_free(r2);
+    _mm_free(k);
+    _mm_free(ids);
+    cx = cy = cz = r2 = k = nullptr;
+    ids = nullptr;
+    size = 0;
+}
+
+void RayPacket::add(const Ray &r) {
+    const RayF rf(r);
+    const int i = count++;
+    ox[i] = rf.ox; oy[i] = rf.oy; oz[i] = rf.oz;
+    dx[i] = rf.dx; dy[i] = rf.dy; dz[i] = rf.dz;
+    ix[i] = safe_inv(r.d.x);
+    iy[i] = safe_inv(r.d.y);
+    iz[i] = safe_inv(r.d.z);
+    oo[i] = rf.oo;
+    t[i] = 1e20f;
+    id[i] = -1;
+}
+
+void RayPacket::pad() {
+    for (int i = count; i < PACKET_SIZE; ++i) {
+        ox[i] = ox[0]; oy[i] = oy[0]; oz[i] = oz[0];
+        dx[i] = dx[0]; dy[i] = dy[0]; dz[i] = dz[0];
+        ix[i] = ix[0]; iy[i] = iy[0]; iz[i] = iz[0];
+        oo[i] = oo[0];
+        t[i] = 1e20f;
+        id[i] = -1;
+    }
+}
\ No newline at end of file
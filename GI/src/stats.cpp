@@ -0,0 +1,59 @@
+#include "stats.h"
+#include <memory>
+#include <string.h>
+
+static RenderStats lastFrame;
+static RenderStats total;
+
+const char* stat_name(int counter) {
+    static const char* names[STAT_COUNT] = {
+        "camera_rays", "shadow_rays", "bsdf_rays", "rr_terminations", "depth_cutoffs",
+        "tir_events", "scene_queries", "occlusion_queries", "node_visits", "sphere_tests",
+    };
+    return counter >= 0 && counter < STAT_COUNT ? names[counter] : "unknown";
+}
+
+#ifdef GI_ENABLE_STATS
+thread_local ThreadStats thread_stats;
+
+static std::unique_ptr<ThreadStats[]> slots; // 每个线程一个缓存行
+static int numSlots = 0;
+
+void stats_begin_frame(int numThreads) {
+    if (numThreads != numSlots) {
+        slots.reset(new ThreadStats[numThreads]);
+        numSlots = numThreads;
+    }
+    memset(slots.get(), 0, sizeof(ThreadStats) * numSlots);
+}
+
+void stats_thread_begin() {
+    memset(&thread_stats, 0, sizeof(thread_stats));
+}
+
+void stats_thread_end(int thread) {
+    slots[thread] = thread_stats;
+}
+
+void stats_end_frame() {
+    lastFrame = RenderStats();
+    for (int t = 0; t < numSlots; ++t)
+        for (int i = 0; i < STAT_COUNT; ++i)
+            lastFrame.counters[i] += slots[t].counters[i];
+    for (int i = 0; i < STAT_COUNT; ++i)
+        total.counters[i] += lastFrame.counters[i];
+}
+#endif
+
+const RenderStats& stats_last_frame() {
+    return lastFrame;
+}
+
+const RenderStats& stats_total() {
+    return total;
+}
+
+void stats_reset() {
+    lastFrame = RenderStats();
+    total = RenderStats();
+}
\ No newline at end of file
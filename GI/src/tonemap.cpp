@@ -0,0 +1,109 @@
+#include "tonemap.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// 查找表的范围和精度：[2^-20, 1]，每个2倍区间2^5格
+static const int LUT_OCTAVES = 20;
+static const int LUT_SHIFT = 23 - 5;
+static const uint32_t LUT_BASE = (127 - LUT_OCTAVES) << (23 - LUT_SHIFT);
+static const int LUT_SIZE = (LUT_OCTAVES << (23 - LUT_SHIFT)) + 1;   // 最后一格对应1.0
+static const float LUT_MIN = 1.0f / (1 << LUT_OCTAVES);
+
+// 每格起点的显示值（0~255）和到下一格的增量
+struct GammaTable {
+    float value[LUT_SIZE], slope[LUT_SIZE];
+
+    GammaTable() {
+        for (int i = 0; i < LUT_SIZE; ++i) value[i] = float(255 * pow(grid(i), 1 / 2.2));
+        for (int i = 0; i + 1 < LUT_SIZE; ++i) slope[i] = value[i + 1] - value[i];
+        slope[LUT_SIZE - 1] = 0;
+    }
+
+    static double grid(int i) {
+        const uint32_t bits = (LUT_BASE + i) << LUT_SHIFT;
+        float x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+};
+static const GammaTable gamma_table;
+
+// 色调映射前输入的上限，远超任何算子的饱和点
+static const float TONEMAP_MAX_INPUT = 1e4f;
+
+// 每块的通道数，Vec输入先转成float放在栈上
+static const int BLOCK = 768;
+
+template <int OP>
+static inline float tone_map(float c) {
+    if (OP == TONEMAP_REINHARD) return c / (1 + c);
+    if (OP == TONEMAP_ACES) return (c * (2.51f * c + 0.03f)) / (c * (2.43f * c + 0.59f) + 0.14f);
+    return c;
+}
+
+// 整数哈希，由值的序号得到两个独立的均匀随机数
+static inline uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// 各数组互不重叠，单独成函数并标注__restrict，循环才能向量化。
+// 查表编译为gather，GCC仍无法排除它与8位输出的存储重叠，用ivdep说明循环各次迭代之间没有依赖
+template <int OP, bool DITHER>
+static void map_block(int n, const float* __restrict in, uint8_t* __restrict out, float exposure, uint32_t index0,
+                      const float* __restrict value, const float* __restrict slope) {
+    #pragma GCC ivdep
+    for (int x = 0; x < n; ++x) {
+        // 先截断到有限的范围：ACES拟合式在很大的输入下分子分母都溢出为inf，结果为NaN
+        const float e = fminf(fmaxf(in[x] * exposure, 0.0f), TONEMAP_MAX_INPUT);
+        const float c = fminf(fmaxf(tone_map<OP>(e), 0.0f), 1.0f);
+        union {float f; uint32_t u;} v;
+        v.f = c;
+        const uint32_t bits = v.u;
+        const int k = int(bits >> LUT_SHIFT) - int(LUT_BASE);
+        const int i = k < 0 ? 0 : k > LUT_SIZE - 1 ? LUT_SIZE - 1 : k;
+        const float f = float(bits & ((1u << LUT_SHIFT) - 1)) * (1.0f / (1 << LUT_SHIFT));
+        float g = c < LUT_MIN ? 0.0f : value[i] + slope[i] * f;
+        if (DITHER) {
+            // 两个均匀分布之差为[-1, 1]上的三角分布；纯黑和纯白不加噪声
+            const uint32_t r = hash(index0 + uint32_t(x));
+            const float noise = float(r & 0xffff) * (1.0f / 65536) - float(r >> 16) * (1.0f / 65536);
+            g = (c > 0 && c < 1) ? fminf(fmaxf(g + noise, 0.0f), 255.0f) : g;
+        }
+        out[x] = uint8_t(int(g + 0.5f));
+    }
+}
+
+template <int OP>
+static void map_block(int n, const float* in, uint8_t* out, const ToneMapping &tm, uint32_t index0) {
+    if (tm.dither) map_block<OP, true>(n, in, out, tm.exposure, index0, gamma_table.value, gamma_table.slope);
+    else map_block<OP, false>(n, in, out, tm.exposure, index0, gamma_table.value, gamma_table.slope);
+}
+
+void tonemap_8bit(const float* in, int n, uint8_t* out, const ToneMapping &tm, uint32_t index0) {
+    switch (tm.op) {
+    case TONEMAP_REINHARD: map_block<TONEMAP_REINHARD>(n, in, out, tm, index0); break;
+    case TONEMAP_ACES:     map_block<TONEMAP_ACES>(n, in, out, tm, index0); break;
+    default:               map_block<TONEMAP_CLAMP>(n, in, out, tm, index0); break;
+    }
+}
+
+void tonemap_rgb8(const Vec* in, int n, uint8_t* out, const ToneMapping &tm) {
+    const int blocks = (n * 3 + BLOCK - 1) / BLOCK;
+    #pragma omp parallel for
+    for (int b = 0; b < blocks; ++b) {
+        float buf[BLOCK];
+        const int p0 = b * (BLOCK / 3), p1 = std::min(n, p0 + BLOCK / 3);
+        for (int p = p0; p < p1; ++p) {
+            buf[(p - p0) * 3]     = float(in[p].x);
+            buf[(p - p0) * 3 + 1] = float(in[p].y);
+            buf[(p - p0) * 3 + 2] = float(in[p].z);
+        }
+        tonemap_8bit(buf, (p1 - p0) * 3, out + p0 * 3, tm, uint32_t(p0) * 3);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "wavefront.h"
+#include "scene.h"
+#include "shading.h"
+#include "sphere_simd.h"
+#include "stats.h"
+#include <algorithm>
+
+// 新路径的光线都来自相机或镜面/折射，材质采样pdf为0
+int Wavefront::add_path(const Ray &r, const Vec &t, int d, int smp, const Sampler &sampler, uint32_t s) {
+    ox.push_back(r.o.x); oy.push_back(r.o.y); oz.push_back(r.o.z);
+    dx.push_back(r.d.x); dy.push_back(r.d.y); dz.push_back(r.d.z);
+    tx.push_back(t.x); ty.push_back(t.y); tz.push_back(t.z);
+    rrScale.push_back(1);
+    depth.push_back(d);
+    sample.push_back(smp);
+    stream.push_back(s);
+    for (auto *v : {&px, &py, &pz, &pnx, &pny, &pnz, &bsdfPdf}) v->push_back(0);
+    samplers.push_back(sampler);
+    hitT.push_back(0);
+    hitId.push_back(-1);
+    return numPaths++;
+}
+
+void Wavefront::set_ray(int i, const Ray &r) {
+    ox[i] = r.o.x; oy[i] = r.o.y; oz[i] = r.o.z;
+    dx[i] = r.d.x; dy[i] = r.d.y; dz[i] = r.d.z;
+}
+
+Ray Wavefront::ray(int i) const {
+    Ray r;
+    r.o = Vec(ox[i], oy[i], oz[i]);
+    r.d = Vec(dx[i], dy[i], dz[i]);
+    return r;
+}
+
+void Wavefront::trace(const uint32_t* pixels, int n, const CameraFrame &frame, Film &film) {
+    for (auto *v : {&ox, &oy, &oz, &dx, &dy, &dz, &tx, &ty, &tz, &rrScale, &px, &py, &pz, &pnx, &pny, &pnz, &bsdfPdf})
+        v->clear();
+    depth.clear();
+    sample.clear();
+    stream.clear();
+    samplers.clear();
+    hitT.clear();
+    hitId.clear();
+    numPaths = 0;
+    active.clear();
+
+    generate(pixels, n, frame, film);
+    while (!active.empty()) {
+        extend();
+        classify();
+        next.clear();
+        shade_diffuse();
+        shade_specular();
+        shade_refractive();
+        connect();
+        active.swap(next);
+    }
+
+    for (int i = 0; i < n; ++i) film.add_sample(pixels[i], sampleL[i], sampleFeatures[i]);
+}
+
+// 生成每个像素的相机光线，随机采样器下前4个维度一次批量生成
+void Wavefront::generate(const uint32_t* pixels, int n, const CameraFrame &frame, const Film &film) {
+    sampleL.assign(n, Vec());
+    sampleFeatures.assign(n, HitFeatures());
+    sampleIndex.resize(n);
+    for (int i = 0; i < n; ++i) sampleIndex[i] = film.next[pixels[i]];
+    const bool batch = render_sampler == SAMPLER_RANDOM;
+    if (batch) {
+        firstBlocks.resize(n * 4);
+        philox_first_block_batch(pixels, sampleIndex.data(), n, firstBlocks.data());
+    }
+
+    for (int i = 0; i < n; ++i) {
+        Sampler sampler = batch ? Sampler(pixels[i], sampleIndex[i], &firstBlocks[i * 4])
+                                : Sampler(pixels[i], sampleIndex[i]);
+        Ray r = frame.generate(pixels[i] % frame.w, pixels[i] / frame.w, sampler);
+        GI_STAT(STAT_CAMERA_RAYS);
+        active.push_back(add_path(r, Vec(1, 1, 1), 0, i, sampler, 0));
+    }
+}
+
+// 按方向卦限做计数排序后整包求交，同一包内光线的方向符号一致，区间剔除更有效
+void Wavefront::extend() {
+    auto octant = [&](int i) {return (dx[i] < 0) | (dy[i] < 0) << 1 | (dz[i] < 0) << 2;};
+    int offsets[9] = {};
+    for (int i : active) ++offsets[octant(i) + 1];
+    for (int o = 0; o < 8; ++o) offsets[o + 1] += offsets[o];
+    next.resize(active.size());
+    for (int i : active) next[offsets[octant(i)]++] = i;
+    active.swap(next);
+
+    RayPacket packet;
+    for (size_t first = 0; first < active.size(); first += PACKET_SIZE) {
+        const size_t last = std::min(first + PACKET_SIZE, active.size());
+        packet.count = 0;
+        for (size_t k = first; k < last; ++k) packet.add(ray(active[k]));
+        scene_intersect_packet(packet);
+        for (size_t k = first; k < last; ++k) {
+            hitT[active[k]] = packet.t[k - first];
+            hitId[active[k]] = packet.id[k - first];
+        }
+    }
+}
+
+// 处理路径终止条件并按材质分桶，自发光在此计入（按MIS加权）
+void Wavefront::classify() {
+    for (auto &q : queues) q.clear();
+    for (int i : active) {
+        const int id = hitId[i];
+        if (id < 0) continue; // 未命中为黑色
+
+        if (depth[i] == 0 && stream[i] == 0) sampleFeatures[sample[i]] = hit_features(ray(i), hitT[i], id);
+
+        const Sphere &obj = spheres[id];
+        const Vec &f = obj.c;
+        const bool emissive = is_emitter(obj);
+        const Vec emitted = emissive ? obj.e * emission_weight(id, Vec(px[i], py[i], pz[i]),
+                                                               Vec(pnx[i], pny[i], pnz[i]), bsdfPdf[i]) : Vec();
+        rrScale[i] = 1;
+
+        if (depth[i] > 30) {
+            GI_STAT(STAT_DEPTH_CUTOFFS);
+            if (emissive) sampleL[sample[i]] = madd(throughput(i), emitted, sampleL[sample[i]]);
+            continue;
+        }
+
+        // 俄罗斯轮盘赌终止条件
+        if (++depth[i] > 8) {
+            Real p = f.x > f.y && f.x > f.z ? f.x : (f.y > f.z ? f.y : f.z);
+            p = std::max(p, Real(0.1)); // 避免过小的概率值
+            if (samplers[i].get1D(bounce_dim(depth[i] - 1, BOUNCE_RR)) >= p) {
+                GI_STAT(STAT_RR_TERMINATIONS);
+                if (emissive) sampleL[sample[i]] = madd(throughput(i), emitted, sampleL[sample[i]]);
+                continue;
+            }
+            rrScale[i] = 1.0/p; // 补偿能量
+        }
+
+        if (emissive) sampleL[sample[i]] = madd(throughput(i), emitted, sampleL[sample[i]]);
+        queues[obj.refl].push_back(i);
+    }
+}
+
+// 由交点距离恢复交点、法线和朝向入射侧的法线
+static void surface(const Ray &r, Real t, const Sphere &obj, Vec &x, Vec &n, Vec &nl) {
+    x = madd(r.d, t, r.o);
+    n = (x - obj.p).norm();
+    nl = n.dot(r.d) < 0 ? n : n * -1;
+}
+
+void Wavefront::shade_diffuse() {
+    for (int i : queues[DIFF]) {
+        const Ray r = ray(i);
+        const Sphere &obj = spheres[hitId[i]];
+        Vec x, n, nl;
+        surface(r, hitT[i], obj, x, n, nl);
+        const Vec f = obj.c * rrScale[i];
+        const Vec t = throughput(i);
+
+        const int bounce = depth[i] - 1;
+
+        // 直接光源采样：抽取一个光源，阴影光线留到connect统一求交
+        Real lightPmf, u1, u2;
+        const int light = scene_sample_light(x, nl, samplers[i].get1D(bounce_dim(bounce, BOUNCE_LIGHT)), lightPmf);
+        samplers[i].get2D(bounce_dim(bounce, BOUNCE_LIGHT_U), u1, u2);
+        Ray shadowRay;
+        Real lightDist;
+        Vec contrib;
+        if (light >= 0 && connect_light(spheres[light], lightPmf, x, nl, f, u1, u2, shadowRay, lightDist, contrib)) {
+            GI_STAT(STAT_SHADOW_RAYS);
+            shadowRays.push_back(shadowRay);
+            shadowTmax.push_back(shadow_tmax(lightDist));
+            shadowContrib.push_back(t.mult(contrib));
+            shadowSample.push_back(sample[i]);
+        }
+
+        set_throughput(i, t.mult(f));
+        samplers[i].get2D(bounce_dim(bounce, BOUNCE_BSDF_U), u1, u2);
+        const Vec d = sample_diffuse(nl, u1, u2);
+        set_ray(i, Ray(x, d));
+        px[i] = x.x; py[i] = x.y; pz[i] = x.z;
+        pnx[i] = nl.x; pny[i] = nl.y; pnz[i] = nl.z;
+        bsdfPdf[i] = diffuse_pdf(nl.dot(d));
+        GI_STAT(STAT_BSDF_RAYS);
+        next.push_back(i);
+    }
+}
+
+void Wavefront::shade_specular() {
+    for (int i : queues[SPEC]) {
+        const Ray r = ray(i);
+        const Sphere &obj = spheres[hitId[i]];
+        Vec x, n, nl;
+        surface(r, hitT[i], obj, x, n, nl);
+
+        set_throughput(i, throughput(i).mult(obj.c * rrScale[i]));
+        set_ray(i, Ray(x, reflect(r.d, n)));
+        bsdfPdf[i] = 0;
+        GI_STAT(STAT_BSDF_RAYS);
+        next.push_back(i);
+    }
+}
+
+// depth<=2时反射和折射都追踪：折射沿用当前槽位，反射分出新路径，使用编号不重复的采样器子序列
+void Wavefront::shade_refractive() {
+    for (int i : queues[REFR]) {
+        const Ray r = ray(i);
+        const Sphere &obj = spheres[hitId[i]];
+        Vec x, n, nl;
+        surface(r, hitT[i], obj, x, n, nl);
+        const Vec t = throughput(i).mult(obj.c * rrScale[i]);
+        bsdfPdf[i] = 0;
+
+        Ray reflRay(x, reflect(r.d, n));
+        Vec tdir;
+        Real Re;
+
+        // 全反射处理
+        if (!refract_dielectric(r.d, n, nl, tdir, Re)) {
+            GI_STAT(STAT_TIR_EVENTS);
+            GI_STAT(STAT_BSDF_RAYS);
+            set_throughput(i, t);
+            set_ray(i, reflRay);
+            next.push_back(i);
+            continue;
+        }
+        Real Tr = 1 - Re;
+
+        if (depth[i] > 2) {
+            // 重要性采样：只选择一条分支
+            GI_STAT(STAT_BSDF_RAYS);
+            Real P = 0.25 + 0.5*Re;
+            if (samplers[i].get1D(bounce_dim(depth[i] - 1, BOUNCE_LOBE)) < P) {
+                set_throughput(i, t * (Re/P));
+                set_ray(i, reflRay);
+            } else {
+                set_throughput(i, t * (Tr/(1 - P)));
+                set_ray(i, Ray(x, tdir));
+            }
+        } else {
+            GI_STAT_ADD(STAT_BSDF_RAYS, 2);
+            const uint32_t childStream = stream[i] * 4 + depth[i] + 1;
+            const Sampler child = samplers[i].substream(childStream);
+            next.push_back(add_path(reflRay, t * Re, depth[i], sample[i], child, childStream));
+            set_throughput(i, t * Tr);
+            set_ray(i, Ray(x, tdir));
+        }
+        next.push_back(i);
+    }
+}
+
+// 阴影光线整包做可见性测试，未被遮挡的直接光照计入所属采样
+void Wavefront::connect() {
+    RayPacket packet;
+    for (size_t first = 0; first < shadowRays.size(); first += PACKET_SIZE) {
+        const size_t last = std::min(first + PACKET_SIZE, shadowRays.size());
+        packet.count = 0;
+        for (size_t k = first; k < last; ++k) {
+            packet.add(shadowRays[k]);
+            packet.t[k - first] = (float)shadowTmax[k];
+        }
+        scene_occluded_packet(packet);
+        for (size_t k = first; k < last; ++k) {
+            if (packet.id[k - first] < 0)
+                sampleL[shadowSample[k]] = sampleL[shadowSample[k]] + shadowContrib[k];
+        }
+    }
+    shadowRays.clear();
+    shadowTmax.clear();
+    shadowContrib.clear();
+    shadowSample.clear();
+}
\ No newline at end of file